@@ -0,0 +1,320 @@
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "endgame.hpp"
+#include "eval.hpp"
+#include "probcut.hpp"
+#include "search.hpp"
+using namespace std;
+
+/*
+ * Batch position analyzer.
+ *
+ * Reads positions one per line from a file or stdin: 64 squares a1 .. h8 in
+ * setBoard() form ('b' black, 'w' white, anything else empty) from the first
+ * character of the line, then the side to move, b or w, after a space. Blank
+ * lines and lines starting with '#' are skipped. Each position is searched
+ * to a fixed depth, or solved exactly from -e empties, and answered with one
+ * line:
+ *
+ *   <line> <move> <score> <depth> <nodes>
+ *
+ * where line is the input line number, move is a1 .. h8 or pass, score is
+ * for the side to move (evaluation units, or the final disc margin when
+ * solved) and depth is the search depth or "exact". A line that cannot be
+ * read is answered with "<line> error <reason>".
+ *
+ * The reader hands positions to a pool of worker threads, each with its own
+ * search, solver and transposition table; the weights are shared. At most
+ * -q positions are read and not yet written at any time, so memory stays
+ * bounded however long the input is. Results are written in input order
+ * (held back until the ones before them are written), or with -u as soon as
+ * they are ready; either way each is flushed as soon as it is written.
+ */
+
+struct AnalyzerOptions {
+    int workers;
+    int depth;
+    int exactEmpties;
+    int ttSizeMb;           // per worker
+    int window;             // positions read and not yet written
+    bool ordered;
+    const char *input;      // nullptr: stdin
+    const char *weights;    // nullptr: square weights
+    const char *probCut;    // nullptr: full-width search
+};
+
+/*
+ * A position to analyse: its input line and its sequence number among the
+ * positions; error is set instead of the position if the line is malformed.
+ */
+struct Task {
+    long long line;
+    long long seq;
+    char data[64];
+    Side side;
+    string error;
+};
+
+/*
+ * A written or pending answer, in the slot seq % window of the reorder ring.
+ */
+struct Answer {
+    bool ready;
+    string text;
+};
+
+static mutex analyzerLock;          // guards everything below and the output
+static condition_variable taskReady;
+static condition_variable spaceFree;
+static deque<Task> tasks;
+static vector<Answer> ring;
+static long long nextToWrite;       // sequence number of the next answer in order
+static long long inFlight;          // read and not yet written
+static bool endOfInput;
+
+static PatternEval eval;
+static ProbCut probCut;
+
+/*
+ * Reads one input line into task; false (with task.error set) if it is
+ * not a position.
+ */
+static bool parseLine(const string &text, Task &task) {
+    // taken as they are: a space is an empty square
+    if (text.size() < 64) {
+        task.error = "expected 64 squares and a side to move";
+        return false;
+    }
+    memcpy(task.data, text.data(), 64);
+    size_t side = text.find_first_not_of(" \t\r", 64);
+    if (side == string::npos || side == 64) {
+        task.error = "expected 64 squares and a side to move";
+        return false;
+    }
+    char c = text[side];
+    if (c != 'b' && c != 'w' && c != 'B' && c != 'W') {
+        task.error = "side to move must be b or w";
+        return false;
+    }
+    task.side = (c == 'b' || c == 'B') ? BLACK : WHITE;
+    return true;
+}
+
+/*
+ * Writes the answer of sequence number seq, or keeps it in the ring until
+ * the answers before it are written; the caller holds analyzerLock.
+ */
+static void deliver(const AnalyzerOptions &options, long long seq, const string &text) {
+    if (!options.ordered) {
+        fputs(text.c_str(), stdout);
+        fflush(stdout);
+        inFlight--;
+        spaceFree.notify_one();
+        return;
+    }
+
+    Answer &answer = ring[seq % options.window];
+    answer.ready = true;
+    answer.text = text;
+    while (ring[nextToWrite % options.window].ready) {
+        Answer &next = ring[nextToWrite % options.window];
+        fputs(next.text.c_str(), stdout);
+        next.ready = false;
+        next.text.clear();
+        nextToWrite++;
+        inFlight--;
+    }
+    fflush(stdout);
+    spaceFree.notify_one();
+}
+
+/*
+ * The answer line of one position.
+ */
+static string analyse(const AnalyzerOptions &options, Task &task, Search &search, EndgameSolver &solver,
+                      TranspositionTable &tt) {
+    char text[128];
+    if (!task.error.empty()) {
+        snprintf(text, sizeof(text), "%lld error %s\n", task.line, task.error.c_str());
+        return text;
+    }
+
+    Board board;
+    board.setBoard(task.data);
+    int empties = 64 - board.countBlack() - board.countWhite();
+    int moveId;
+    int score;
+    long long nodes;
+    tt.newSearch();
+    if (empties <= options.exactEmpties) {
+        score = solver.solveRoot(board, task.side, moveId);
+        nodes = solver.getNodes();
+        snprintf(text, sizeof(text), "%lld %s %d exact %lld\n", task.line, squareName(moveId).c_str(), score, nodes);
+    }
+    else {
+        SearchLimits limits;
+        limits.maxDepth = options.depth;
+        search.setPosition(board);
+        score = search.iterativeDeepening(task.side, limits, moveId);
+        nodes = search.getNodes();
+        snprintf(text, sizeof(text), "%lld %s %d %d %lld\n", task.line, squareName(moveId).c_str(), score,
+                 search.getDepthReached(), nodes);
+    }
+    return text;
+}
+
+/*
+ * Worker thread: analyses positions until the input is over and the queue
+ * empty.
+ */
+static void worker(const AnalyzerOptions &options) {
+    TranspositionTable tt(options.ttSizeMb);
+    Board start;
+    Search search(start, &tt);
+    if (options.weights != nullptr)
+        search.setEvaluation(&eval);
+    if (options.probCut != nullptr)
+        search.setProbCut(&probCut);
+    EndgameSolver solver(&tt);
+
+    while (true) {
+        Task task;
+        {
+            unique_lock<mutex> lock(analyzerLock);
+            taskReady.wait(lock, []() { return !tasks.empty() || endOfInput; });
+            if (tasks.empty())
+                return;
+            task = tasks.front();
+            tasks.pop_front();
+        }
+
+        string text = analyse(options, task, search, solver, tt);
+        lock_guard<mutex> lock(analyzerLock);
+        deliver(options, task.seq, text);
+    }
+}
+
+static void usage(const char *name) {
+    cerr << "usage: " << name << " [-i file] [-j workers] [-d depth] [-e empties] [-t MB] [-q positions] [-u]"
+         << " [-w weights] [-c probcut]" << endl
+         << "  -i  positions to read (default stdin)" << endl
+         << "  -j  worker threads (default: one per core)" << endl
+         << "  -d  search depth (default 8)" << endl
+         << "  -e  solve exactly from this many empties (default 16)" << endl
+         << "  -t  transposition table of each worker, in MB (default 16)" << endl
+         << "  -q  positions read ahead of the output at most (default 64 per worker)" << endl
+         << "  -u  write results as they are ready instead of in input order" << endl
+         << "  -w  pattern weights, or square for square weights (default othello.weights)" << endl
+         << "  -c  Multi-ProbCut parameters for those weights, or none (default none)" << endl;
+    exit(-1);
+}
+
+int main(int argc, char *argv[]) {
+    AnalyzerOptions options;
+    options.workers = (int) thread::hardware_concurrency();
+    options.depth = 8;
+    options.exactEmpties = 16;
+    options.ttSizeMb = 16;
+    options.window = 0;
+    options.ordered = true;
+    options.input = nullptr;
+    options.weights = "othello.weights";
+    options.probCut = nullptr;
+
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (!strcmp(argv[i], "-i") && hasValue)
+            options.input = argv[++i];
+        else if (!strcmp(argv[i], "-j") && hasValue)
+            options.workers = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-d") && hasValue)
+            options.depth = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-e") && hasValue)
+            options.exactEmpties = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-t") && hasValue)
+            options.ttSizeMb = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-q") && hasValue)
+            options.window = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-u"))
+            options.ordered = false;
+        else if (!strcmp(argv[i], "-w") && hasValue) {
+            ++i;
+            options.weights = strcmp(argv[i], "square") ? argv[i] : nullptr;
+        }
+        else if (!strcmp(argv[i], "-c") && hasValue) {
+            ++i;
+            options.probCut = strcmp(argv[i], "none") ? argv[i] : nullptr;
+        }
+        else
+            usage(argv[0]);
+    }
+    if (options.depth < 1 || options.depth > MAX_SEARCH_DEPTH || options.ttSizeMb < 1 || options.window < 0)
+        usage(argv[0]);
+    if (options.workers < 1)
+        options.workers = 1;
+    if (options.window == 0)
+        options.window = 64 * options.workers;
+
+    // as the player does: the default pattern weights if the file is missing
+    if (options.weights != nullptr && !eval.load(options.weights))
+        cerr << "analyzer: cannot read weights " << options.weights << ", using the default pattern weights" << endl;
+    if (options.probCut != nullptr && !probCut.load(options.probCut)) {
+        cerr << "cannot read Multi-ProbCut parameters " << options.probCut << endl;
+        return 1;
+    }
+
+    ifstream file;
+    if (options.input != nullptr) {
+        file.open(options.input);
+        if (!file) {
+            cerr << "cannot read positions " << options.input << endl;
+            return 1;
+        }
+    }
+    istream &in = options.input != nullptr ? file : cin;
+
+    ring.assign(options.window, Answer());
+    vector<thread> workers;
+    for (int i = 0; i < options.workers; i++)
+        workers.push_back(thread(worker, cref(options)));
+
+    // read ahead only as far as the window allows
+    string text;
+    long long line = 0;
+    long long seq = 0;
+    while (getline(in, text)) {
+        line++;
+        size_t first = text.find_first_not_of(" \t\r");
+        if (first == string::npos || text[0] == '#')
+            continue;
+
+        Task task;
+        task.line = line;
+        task.seq = seq++;
+        parseLine(text, task);
+
+        unique_lock<mutex> lock(analyzerLock);
+        spaceFree.wait(lock, [&]() { return inFlight < options.window; });
+        inFlight++;
+        tasks.push_back(task);
+        taskReady.notify_one();
+    }
+    {
+        lock_guard<mutex> lock(analyzerLock);
+        endOfInput = true;
+    }
+    taskReady.notify_all();
+    for (thread &t : workers)
+        t.join();
+    fflush(stdout);
+    return 0;
+}
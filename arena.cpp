@@ -0,0 +1,353 @@
+#include <iostream>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <atomic>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "player.hpp"
+using namespace std;
+
+/*
+ * Native self-play arena.
+ *
+ * Plays matches between two engine configurations, A and B, with Player
+ * linked in directly, on a pool of worker threads. Every game starts from a
+ * few random plies, and each opening is played twice with the colours
+ * swapped, so that neither side profits from a lucky opening. A game is
+ * lost by a side that plays an illegal move or runs out of its time.
+ *
+ * Each engine's book, pattern weights and Multi-ProbCut parameters are
+ * loaded once and shared by every game; each worker keeps a transposition
+ * table per engine and clears it between games, so starting a game costs
+ * no more than making its two players.
+ */
+
+struct ArenaOptions {
+    int games;
+    int workers;
+    int openingPlies;
+    unsigned seed;
+    PlayerConfig engines[2];    // A and B
+    int timeMs[2];              // per game and side; -1 for untimed
+};
+
+/*
+ * How one game ended, from A's point of view.
+ */
+enum GameResult {
+    A_WINS,
+    B_WINS,
+    DRAWN
+};
+
+// the read-only tables of engines A and B; tt is left to the workers
+static OpeningBook books[2];
+static PatternEval evals[2];
+static ProbCut probCuts[2];
+static SharedTables engineTables[2];
+
+static mutex reportLock;
+static atomic<int> nextGame;
+static long long results[3];
+static long long forfeits[2];   // games A and B lost by an illegal move or on time
+static int gamesDone;
+
+/*
+ * Applies one key=value setting of an engine specification. Returns false
+ * if the key or value is not understood.
+ */
+static bool applySetting(PlayerConfig &config, int &timeMs, const string &key, const string &value) {
+    int number = atoi(value.c_str());
+    if (key == "mode") {
+        if (value == "greedy")
+            config.mode = GREEDY_SEARCH;
+        else if (value == "minimax2")
+            config.mode = MINIMAX_2PLY;
+        else if (value == "minimax")
+            config.mode = MINIMAX_NPLY;
+        else if (value == "alphabeta")
+            config.mode = ALPHABETA_SEARCH;
+        else if (value == "mcts")
+            config.mode = MCTS_SEARCH;
+        else
+            return false;
+    }
+    else if (key == "depth" && number > 0)
+        config.depth = number;
+    else if (key == "time")
+        timeMs = number;
+    else if (key == "tt" && number > 0)
+        config.ttSizeMb = number;
+    else if (key == "threads" && number > 0)
+        config.threads = number;
+    else if (key == "endgame")
+        config.endgameEmpties = number;
+    else if (key == "ordering")
+        config.moveOrdering = number != 0;
+    else if (key == "eval" && (value == "pattern" || value == "square"))
+        config.patternEval = value == "pattern";
+    else if (key == "weights")
+        config.evalPath = value;
+    else if (key == "book")
+        config.bookPath = (value == "none") ? "" : value;
+    else if (key == "probcut")
+        config.probCutPath = (value == "none") ? "" : value;
+    else if (key == "confidence" && atof(value.c_str()) > 0)
+        config.probCutConfidence = atof(value.c_str());
+    else if (key == "playouts" && number > 0)
+        config.mctsPlayouts = atoll(value.c_str());
+    else if (key == "pool" && number > 0)
+        config.mctsMemoryMb = number;
+    else
+        return false;
+    return true;
+}
+
+/*
+ * Reads an engine specification such as "depth=8,eval=square,time=5000".
+ */
+static bool parseEngine(const char *spec, PlayerConfig &config, int &timeMs) {
+    string text(spec);
+    size_t start = 0;
+    while (start < text.size()) {
+        size_t end = text.find(',', start);
+        if (end == string::npos)
+            end = text.size();
+        string setting = text.substr(start, end - start);
+        size_t equals = setting.find('=');
+        if (equals == string::npos
+                || !applySetting(config, timeMs, setting.substr(0, equals), setting.substr(equals + 1)))
+            return false;
+        start = end + 1;
+    }
+    return true;
+}
+
+/*
+ * The position after the given number of random plies, or false if that
+ * happens to end the game. toMove is set to the side to move.
+ */
+static bool makeOpening(int plies, unsigned seed, char data[], Side &toMove) {
+    mt19937 random(seed);
+    Board board;
+    Side side = BLACK;
+    for (int ply = 0; ply < plies; ply++) {
+        Side other = (side == BLACK) ? WHITE : BLACK;
+        MoveList legalMoves;
+        if (board.getLegalMoves(side, legalMoves) > 0)
+            board.makeMove(legalMoves.moves[random() % legalMoves.size], side);
+        else if (board.hasMoves(other))
+            board.makeMove(PASS, side);
+        else
+            return false;
+        side = other;
+    }
+    if (board.isDone())
+        return false;
+
+    uint64_t black = board.getMask(BLACK);
+    uint64_t white = board.getMask(WHITE);
+    for (int sq = 0; sq < 64; sq++)
+        data[sq] = ((black >> sq) & 1) ? 'b' : ((white >> sq) & 1) ? 'w' : ' ';
+    toMove = side;
+    return true;
+}
+
+/*
+ * Plays game number game with the worker's tables of A and B: openings go in
+ * pairs, and A has black in the even games. Returns the result for A;
+ * forfeited is set to the side (0 = A, 1 = B) that lost by an illegal move
+ * or on time, or -1.
+ */
+static GameResult playGame(const ArenaOptions &options, int game, const SharedTables tables[], int &forfeited) {
+    char data[64];
+    Side toMove = BLACK;
+    unsigned openingSeed = options.seed + game / 2;
+    while (!makeOpening(options.openingPlies, openingSeed, data, toMove))
+        openingSeed += 0x9E3779B9u;
+
+    int blackEngine = game % 2;    // 0: A has black
+    Side engineSide[2];
+    engineSide[blackEngine] = BLACK;
+    engineSide[1 - blackEngine] = WHITE;
+
+    Board board;
+    board.setBoard(data);
+    Player *players[2];
+    long long timeLeft[2];
+    for (int e = 0; e < 2; e++) {
+        tables[e].tt->clear();
+        players[e] = new Player(engineSide[e], options.engines[e], tables[e]);
+        players[e]->setBoard(data);
+        timeLeft[e] = options.timeMs[e];
+    }
+
+    forfeited = -1;
+    PackedMove last;
+    Side side = toMove;
+    while (!board.isDone()) {
+        int e = (engineSide[0] == side) ? 0 : 1;
+        SearchClock::time_point start = SearchClock::now();
+        tables[e].tt->newSearch();  // as a player with its own table does
+        PackedMove move = players[e]->play(last, (int) timeLeft[e]);
+        if (timeLeft[e] >= 0) {
+            timeLeft[e] -= chrono::duration_cast<chrono::milliseconds>(SearchClock::now() - start).count();
+            if (timeLeft[e] < 0)
+                forfeited = e;
+        }
+        bool legal = board.checkMove(move, side);
+        if (!legal)
+            forfeited = e;
+        last = move;
+        if (forfeited >= 0)
+            break;
+        board.doMove(move, side);
+        side = (side == BLACK) ? WHITE : BLACK;
+    }
+    delete players[0];
+    delete players[1];
+
+    if (forfeited >= 0)
+        return forfeited == 0 ? B_WINS : A_WINS;
+    int margin = board.count(engineSide[0]) - board.count(engineSide[1]);
+    return margin > 0 ? A_WINS : margin < 0 ? B_WINS : DRAWN;
+}
+
+/*
+ * Worker thread: plays games until none are left.
+ */
+static void worker(const ArenaOptions &options) {
+    TranspositionTable ttA(options.engines[0].ttSizeMb);
+    TranspositionTable ttB(options.engines[1].ttSizeMb);
+    SharedTables tables[2] = { engineTables[0], engineTables[1] };
+    tables[0].tt = &ttA;
+    tables[1].tt = &ttB;
+    for (int game = nextGame++; game < options.games; game = nextGame++) {
+        int forfeited;
+        GameResult result = playGame(options, game, tables, forfeited);
+
+        lock_guard<mutex> lock(reportLock);
+        results[result]++;
+        if (forfeited >= 0)
+            forfeits[forfeited]++;
+        gamesDone++;
+        int step = options.games >= 10 ? options.games / 10 : 1;
+        if (gamesDone % step == 0)
+            cerr << "arena: " << gamesDone << "/" << options.games << " games, A "
+                 << results[A_WINS] << "-" << results[B_WINS] << "-" << results[DRAWN] << endl;
+    }
+}
+
+/*
+ * Elo difference that makes the expected score score (strictly between 0
+ * and 1).
+ */
+static double eloFromScore(double score) {
+    return -400.0 * log10(1.0 / score - 1.0) + 0.0;  // + 0.0: no "-0"
+}
+
+static void usage(const char *name) {
+    cerr << "usage: " << name << " [-n games] [-j workers] [-o plies] [-s seed] [-a spec] [-b spec]" << endl
+         << "  -n  games to play (default 100)" << endl
+         << "  -j  games played at once (default: one per core)" << endl
+         << "  -o  random plies before each opening pair (default 8)" << endl
+         << "  -s  seed for the openings (default 1)" << endl
+         << "  -a, -b  engine A and B, as comma-separated key=value settings:" << endl
+         << "      mode=greedy|minimax2|minimax|alphabeta|mcts  depth=N  time=ms per game (-1: untimed)" << endl
+         << "      eval=pattern|square  weights=file  book=file|none  tt=MB  threads=N" << endl
+         << "      endgame=empties  ordering=0|1  playouts=N (mcts, untimed)  pool=MB (mcts nodes)" << endl
+         << "      probcut=file|none  confidence=sigmas (Multi-ProbCut cut threshold)" << endl
+         << "      (default: alphabeta, depth=4, untimed, endgame=12, 16 MB table, no book, no probcut)" << endl;
+    exit(-1);
+}
+
+int main(int argc, char *argv[]) {
+    ArenaOptions options;
+    options.games = 100;
+    options.workers = (int) thread::hardware_concurrency();
+    options.openingPlies = 8;
+    options.seed = 1;
+    for (int e = 0; e < 2; e++) {
+        options.engines[e].depth = 4;
+        options.engines[e].endgameEmpties = 12;
+        options.engines[e].ttSizeMb = 16;
+        options.engines[e].bookPath = "";
+        options.engines[e].probCutPath = "";
+        options.engines[e].verbose = false;
+        options.timeMs[e] = -1;
+    }
+
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (!strcmp(argv[i], "-n") && hasValue)
+            options.games = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-j") && hasValue)
+            options.workers = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-o") && hasValue)
+            options.openingPlies = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-s") && hasValue)
+            options.seed = (unsigned) atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-a") && hasValue) {
+            if (!parseEngine(argv[++i], options.engines[0], options.timeMs[0]))
+                usage(argv[0]);
+        }
+        else if (!strcmp(argv[i], "-b") && hasValue) {
+            if (!parseEngine(argv[++i], options.engines[1], options.timeMs[1]))
+                usage(argv[0]);
+        }
+        else
+            usage(argv[0]);
+    }
+    if (options.games < 1 || options.openingPlies < 0)
+        usage(argv[0]);
+    if (options.workers < 1)
+        options.workers = 1;
+    if (options.workers > options.games)
+        options.workers = options.games;
+
+    // as a standalone player loads them: missing files leave the defaults
+    for (int e = 0; e < 2; e++) {
+        const PlayerConfig &config = options.engines[e];
+        if (!config.bookPath.empty() && books[e].open(config.bookPath.c_str()))
+            engineTables[e].book = &books[e];
+        if (config.patternEval) {
+            if (!config.evalPath.empty())
+                evals[e].load(config.evalPath.c_str());
+            engineTables[e].eval = &evals[e];
+        }
+        if (!config.probCutPath.empty() && probCuts[e].load(config.probCutPath.c_str()))
+            engineTables[e].probCut = &probCuts[e];
+    }
+
+    SearchClock::time_point start = SearchClock::now();
+    vector<thread> workers;
+    for (int i = 0; i < options.workers; i++)
+        workers.push_back(thread(worker, cref(options)));
+    for (thread &t : workers)
+        t.join();
+    double seconds = chrono::duration<double>(SearchClock::now() - start).count();
+
+    // score of A with a 95% confidence interval, turned into Elo
+    double n = (double) options.games;
+    double score = (results[A_WINS] + 0.5 * results[DRAWN]) / n;
+    double variance = (results[A_WINS] * (1 - score) * (1 - score)
+                       + results[DRAWN] * (0.5 - score) * (0.5 - score)
+                       + results[B_WINS] * score * score) / n;
+    double margin = 1.96 * sqrt(variance / n);
+    double low = min(max(score - margin, 1e-6), 1 - 1e-6);
+    double high = min(max(score + margin, 1e-6), 1 - 1e-6);
+    double clamped = min(max(score, 1e-6), 1 - 1e-6);
+
+    printf("games %d: A wins %lld, B wins %lld, draws %lld (forfeits: A %lld, B %lld)\n",
+           options.games, results[A_WINS], results[B_WINS], results[DRAWN], forfeits[0], forfeits[1]);
+    printf("score %.1f%%, Elo %+.0f (95%%: %+.0f to %+.0f)\n",
+           100 * score, eloFromScore(clamped), eloFromScore(low), eloFromScore(high));
+    printf("%.1f s, %.2f games/s on %d workers\n", seconds, options.games / seconds, options.workers);
+    return 0;
+}
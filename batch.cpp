@@ -0,0 +1,362 @@
+#include "batch.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BATCH_X86 1
+#endif
+
+/*
+ * SQUARE_WEIGHTS split into one mask per distinct non-zero weight, so that a
+ * weighted sum over a mask is a handful of popcounts. Built at compile time,
+ * so the kernels' loops over the classes have a constant trip count.
+ */
+static const int MAX_WEIGHT_CLASSES = 16;
+
+struct WeightClasses {
+    int count;
+    int weight[MAX_WEIGHT_CLASSES];
+    uint64_t mask[MAX_WEIGHT_CLASSES];
+};
+
+static constexpr WeightClasses makeWeightClasses() {
+    WeightClasses classes = {};
+    for (int sq = 0; sq < 64; sq++) {
+        if (SQUARE_WEIGHTS[sq] == 0)
+            continue;
+        int c = 0;
+        while (c < classes.count && classes.weight[c] != SQUARE_WEIGHTS[sq])
+            c++;
+        if (c == classes.count) {
+            classes.weight[classes.count] = SQUARE_WEIGHTS[sq];
+            classes.mask[classes.count++] = 0;
+        }
+        classes.mask[c] |= 1ULL << sq;
+    }
+    return classes;
+}
+
+static constexpr WeightClasses WEIGHT_CLASSES = makeWeightClasses();
+static_assert(WEIGHT_CLASSES.count <= MAX_WEIGHT_CLASSES, "too many distinct square weights");
+
+/*
+ * The direction shifts of getMoves(); only vertical runs (8) may use discs
+ * on the a/h files.
+ */
+static const int DIRECTIONS[4] = { 1, 8, 9, 7 };
+
+/*
+ * Scalar kernels: the reference versions, and the fallback on other CPUs.
+ */
+static void countsScalar(const ChildBatch &batch, int mineCount[], int theirsCount[]) {
+    for (int i = 0; i < batch.size; i++) {
+        mineCount[i] = popCount(batch.mine[i]);
+        theirsCount[i] = popCount(batch.theirs[i]);
+    }
+}
+
+static void mobilityScalar(const ChildBatch &batch, int mobility[]) {
+    for (int i = 0; i < batch.size; i++) {
+        uint64_t P = batch.mine[i];
+        uint64_t O = batch.theirs[i];
+        mobility[i] = popCount(getMoves(P, O)) - popCount(getMoves(O, P));
+    }
+}
+
+static void positionalScalar(const ChildBatch &batch, int scores[]) {
+    for (int i = 0; i < batch.size; i++) {
+        uint64_t P = batch.mine[i];
+        uint64_t O = batch.theirs[i];
+        int score = 0;
+        for (int c = 0; c < WEIGHT_CLASSES.count; c++)
+            score += WEIGHT_CLASSES.weight[c] * (popCount(P & WEIGHT_CLASSES.mask[c]) - popCount(O & WEIGHT_CLASSES.mask[c]));
+        int mobility = popCount(getMoves(P, O)) - popCount(getMoves(O, P));
+        scores[i] = score + MOBILITY_WEIGHT * mobility;
+    }
+}
+
+#ifdef BATCH_X86
+
+/*
+ * AVX2 kernels: four children per vector, one per 64-bit lane. Popcounts use
+ * the nibble lookup table (vpshufb) summed per lane with vpsadbw, and the
+ * move generation is getMoves() with every shift done on all lanes at once.
+ */
+#define AVX2 __attribute__((target("avx2")))
+
+AVX2 static inline __m256i popCount4(__m256i v) {
+    const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                            0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+    __m256i lo = _mm256_and_si256(v, nibble);
+    __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble);
+    __m256i bytes = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, lo), _mm256_shuffle_epi8(lookup, hi));
+    return _mm256_sad_epu8(bytes, _mm256_setzero_si256());
+}
+
+AVX2 static inline __m256i moves4(__m256i P, __m256i O) {
+    const __m256i innerFiles = _mm256_set1_epi64x((long long) INNER_FILES);
+    __m256i inner = _mm256_and_si256(O, innerFiles);
+    __m256i moves = _mm256_setzero_si256();
+    for (int d = 0; d < 4; d++) {
+        __m128i s1 = _mm_cvtsi32_si128(DIRECTIONS[d]);
+        __m128i s2 = _mm_cvtsi32_si128(2 * DIRECTIONS[d]);
+        __m128i s4 = _mm_cvtsi32_si128(4 * DIRECTIONS[d]);
+        __m256i pro = (DIRECTIONS[d] == 8) ? O : inner;
+
+        __m256i gen = P;
+        __m256i p = pro;
+        gen = _mm256_or_si256(gen, _mm256_and_si256(p, _mm256_sll_epi64(gen, s1)));
+        p = _mm256_and_si256(p, _mm256_sll_epi64(p, s1));
+        gen = _mm256_or_si256(gen, _mm256_and_si256(p, _mm256_sll_epi64(gen, s2)));
+        p = _mm256_and_si256(p, _mm256_sll_epi64(p, s2));
+        gen = _mm256_or_si256(gen, _mm256_and_si256(p, _mm256_sll_epi64(gen, s4)));
+        moves = _mm256_or_si256(moves, _mm256_sll_epi64(_mm256_andnot_si256(P, gen), s1));
+
+        gen = P;
+        p = pro;
+        gen = _mm256_or_si256(gen, _mm256_and_si256(p, _mm256_srl_epi64(gen, s1)));
+        p = _mm256_and_si256(p, _mm256_srl_epi64(p, s1));
+        gen = _mm256_or_si256(gen, _mm256_and_si256(p, _mm256_srl_epi64(gen, s2)));
+        p = _mm256_and_si256(p, _mm256_srl_epi64(p, s2));
+        gen = _mm256_or_si256(gen, _mm256_and_si256(p, _mm256_srl_epi64(gen, s4)));
+        moves = _mm256_or_si256(moves, _mm256_srl_epi64(_mm256_andnot_si256(P, gen), s1));
+    }
+    return _mm256_andnot_si256(_mm256_or_si256(P, O), moves);
+}
+
+AVX2 static inline __m256i mobility4(__m256i P, __m256i O) {
+    return _mm256_sub_epi64(popCount4(moves4(P, O)), popCount4(moves4(O, P)));
+}
+
+AVX2 static void countsAvx2(const ChildBatch &batch, int mineCount[], int theirsCount[]) {
+    alignas(32) int64_t mine[BATCH_LANES];
+    alignas(32) int64_t theirs[BATCH_LANES];
+    for (int i = 0; i < batch.size; i += BATCH_LANES) {
+        _mm256_store_si256((__m256i *) mine, popCount4(_mm256_load_si256((const __m256i *) &batch.mine[i])));
+        _mm256_store_si256((__m256i *) theirs, popCount4(_mm256_load_si256((const __m256i *) &batch.theirs[i])));
+        for (int j = 0; j < BATCH_LANES && i + j < batch.size; j++) {
+            mineCount[i + j] = (int) mine[j];
+            theirsCount[i + j] = (int) theirs[j];
+        }
+    }
+}
+
+AVX2 static void mobilityAvx2(const ChildBatch &batch, int mobility[]) {
+    alignas(32) int64_t out[BATCH_LANES];
+    for (int i = 0; i < batch.size; i += BATCH_LANES) {
+        __m256i P = _mm256_load_si256((const __m256i *) &batch.mine[i]);
+        __m256i O = _mm256_load_si256((const __m256i *) &batch.theirs[i]);
+        _mm256_store_si256((__m256i *) out, mobility4(P, O));
+        for (int j = 0; j < BATCH_LANES && i + j < batch.size; j++)
+            mobility[i + j] = (int) out[j];
+    }
+}
+
+AVX2 static void positionalAvx2(const ChildBatch &batch, int scores[]) {
+    alignas(32) int64_t out[BATCH_LANES];
+    for (int i = 0; i < batch.size; i += BATCH_LANES) {
+        __m256i P = _mm256_load_si256((const __m256i *) &batch.mine[i]);
+        __m256i O = _mm256_load_si256((const __m256i *) &batch.theirs[i]);
+        __m256i score = _mm256_mul_epi32(mobility4(P, O), _mm256_set1_epi64x(MOBILITY_WEIGHT));
+        for (int c = 0; c < WEIGHT_CLASSES.count; c++) {
+            __m256i mask = _mm256_set1_epi64x((long long) WEIGHT_CLASSES.mask[c]);
+            __m256i diff = _mm256_sub_epi64(popCount4(_mm256_and_si256(P, mask)),
+                                            popCount4(_mm256_and_si256(O, mask)));
+            score = _mm256_add_epi64(score, _mm256_mul_epi32(diff, _mm256_set1_epi64x(WEIGHT_CLASSES.weight[c])));
+        }
+        _mm256_store_si256((__m256i *) out, score);
+        for (int j = 0; j < BATCH_LANES && i + j < batch.size; j++)
+            scores[i + j] = (int) out[j];
+    }
+}
+
+/*
+ * SSE4 kernels: the same with two children per vector.
+ */
+#define SSE4 __attribute__((target("sse4.1")))
+
+SSE4 static inline __m128i popCount2(__m128i v) {
+    const __m128i lookup = _mm_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m128i nibble = _mm_set1_epi8(0x0F);
+    __m128i lo = _mm_and_si128(v, nibble);
+    __m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), nibble);
+    __m128i bytes = _mm_add_epi8(_mm_shuffle_epi8(lookup, lo), _mm_shuffle_epi8(lookup, hi));
+    return _mm_sad_epu8(bytes, _mm_setzero_si128());
+}
+
+SSE4 static inline __m128i moves2(__m128i P, __m128i O) {
+    const __m128i innerFiles = _mm_set1_epi64x((long long) INNER_FILES);
+    __m128i inner = _mm_and_si128(O, innerFiles);
+    __m128i moves = _mm_setzero_si128();
+    for (int d = 0; d < 4; d++) {
+        __m128i s1 = _mm_cvtsi32_si128(DIRECTIONS[d]);
+        __m128i s2 = _mm_cvtsi32_si128(2 * DIRECTIONS[d]);
+        __m128i s4 = _mm_cvtsi32_si128(4 * DIRECTIONS[d]);
+        __m128i pro = (DIRECTIONS[d] == 8) ? O : inner;
+
+        __m128i gen = P;
+        __m128i p = pro;
+        gen = _mm_or_si128(gen, _mm_and_si128(p, _mm_sll_epi64(gen, s1)));
+        p = _mm_and_si128(p, _mm_sll_epi64(p, s1));
+        gen = _mm_or_si128(gen, _mm_and_si128(p, _mm_sll_epi64(gen, s2)));
+        p = _mm_and_si128(p, _mm_sll_epi64(p, s2));
+        gen = _mm_or_si128(gen, _mm_and_si128(p, _mm_sll_epi64(gen, s4)));
+        moves = _mm_or_si128(moves, _mm_sll_epi64(_mm_andnot_si128(P, gen), s1));
+
+        gen = P;
+        p = pro;
+        gen = _mm_or_si128(gen, _mm_and_si128(p, _mm_srl_epi64(gen, s1)));
+        p = _mm_and_si128(p, _mm_srl_epi64(p, s1));
+        gen = _mm_or_si128(gen, _mm_and_si128(p, _mm_srl_epi64(gen, s2)));
+        p = _mm_and_si128(p, _mm_srl_epi64(p, s2));
+        gen = _mm_or_si128(gen, _mm_and_si128(p, _mm_srl_epi64(gen, s4)));
+        moves = _mm_or_si128(moves, _mm_srl_epi64(_mm_andnot_si128(P, gen), s1));
+    }
+    return _mm_andnot_si128(_mm_or_si128(P, O), moves);
+}
+
+SSE4 static inline __m128i mobility2(__m128i P, __m128i O) {
+    return _mm_sub_epi64(popCount2(moves2(P, O)), popCount2(moves2(O, P)));
+}
+
+SSE4 static void countsSse4(const ChildBatch &batch, int mineCount[], int theirsCount[]) {
+    alignas(16) int64_t mine[2];
+    alignas(16) int64_t theirs[2];
+    for (int i = 0; i < batch.size; i += 2) {
+        _mm_store_si128((__m128i *) mine, popCount2(_mm_load_si128((const __m128i *) &batch.mine[i])));
+        _mm_store_si128((__m128i *) theirs, popCount2(_mm_load_si128((const __m128i *) &batch.theirs[i])));
+        for (int j = 0; j < 2 && i + j < batch.size; j++) {
+            mineCount[i + j] = (int) mine[j];
+            theirsCount[i + j] = (int) theirs[j];
+        }
+    }
+}
+
+SSE4 static void mobilitySse4(const ChildBatch &batch, int mobility[]) {
+    alignas(16) int64_t out[2];
+    for (int i = 0; i < batch.size; i += 2) {
+        __m128i P = _mm_load_si128((const __m128i *) &batch.mine[i]);
+        __m128i O = _mm_load_si128((const __m128i *) &batch.theirs[i]);
+        _mm_store_si128((__m128i *) out, mobility2(P, O));
+        for (int j = 0; j < 2 && i + j < batch.size; j++)
+            mobility[i + j] = (int) out[j];
+    }
+}
+
+SSE4 static void positionalSse4(const ChildBatch &batch, int scores[]) {
+    alignas(16) int64_t out[2];
+    for (int i = 0; i < batch.size; i += 2) {
+        __m128i P = _mm_load_si128((const __m128i *) &batch.mine[i]);
+        __m128i O = _mm_load_si128((const __m128i *) &batch.theirs[i]);
+        __m128i score = _mm_mul_epi32(mobility2(P, O), _mm_set1_epi64x(MOBILITY_WEIGHT));
+        for (int c = 0; c < WEIGHT_CLASSES.count; c++) {
+            __m128i mask = _mm_set1_epi64x((long long) WEIGHT_CLASSES.mask[c]);
+            __m128i diff = _mm_sub_epi64(popCount2(_mm_and_si128(P, mask)),
+                                         popCount2(_mm_and_si128(O, mask)));
+            score = _mm_add_epi64(score, _mm_mul_epi32(diff, _mm_set1_epi64x(WEIGHT_CLASSES.weight[c])));
+        }
+        _mm_store_si128((__m128i *) out, score);
+        for (int j = 0; j < 2 && i + j < batch.size; j++)
+            scores[i + j] = (int) out[j];
+    }
+}
+
+#endif
+
+/*
+ * The kernels in use.
+ */
+static BatchKernel kernel = BATCH_SCALAR;
+static void (*countsKernel)(const ChildBatch &, int[], int[]) = countsScalar;
+static void (*mobilityKernel)(const ChildBatch &, int[]) = mobilityScalar;
+static void (*positionalKernel)(const ChildBatch &, int[]) = positionalScalar;
+
+/*
+ * Picks the widest kernels the CPU supports before main() runs.
+ */
+static struct BatchInit {
+    BatchInit() {
+        if (!selectBatchKernel(BATCH_AVX2))
+            selectBatchKernel(BATCH_SSE4);
+    }
+} batchInit;
+
+BatchKernel getBatchKernel() {
+    return kernel;
+}
+
+bool selectBatchKernel(BatchKernel wanted) {
+    switch (wanted) {
+    case BATCH_SCALAR:
+        countsKernel = countsScalar;
+        mobilityKernel = mobilityScalar;
+        positionalKernel = positionalScalar;
+        break;
+#ifdef BATCH_X86
+    case BATCH_SSE4:
+        __builtin_cpu_init();
+        if (!__builtin_cpu_supports("sse4.1"))
+            return false;
+        countsKernel = countsSse4;
+        mobilityKernel = mobilitySse4;
+        positionalKernel = positionalSse4;
+        break;
+    case BATCH_AVX2:
+        __builtin_cpu_init();
+        if (!__builtin_cpu_supports("avx2"))
+            return false;
+        countsKernel = countsAvx2;
+        mobilityKernel = mobilityAvx2;
+        positionalKernel = positionalAvx2;
+        break;
+#endif
+    default:
+        return false;
+    }
+    kernel = wanted;
+    return true;
+}
+
+const char *batchKernelName(BatchKernel which) {
+    switch (which) {
+    case BATCH_SSE4:
+        return "sse4";
+    case BATCH_AVX2:
+        return "avx2";
+    default:
+        return "scalar";
+    }
+}
+
+/*
+ * Plays each move into its own slot. The slots after the last child, up to
+ * the next whole group of lanes, are cleared so the kernels can read them.
+ */
+void generateChildren(uint64_t mine, uint64_t theirs, const int moves[], int count, ChildBatch &batch) {
+    int i;
+    for (i = 0; i < count; i++) {
+        int moveId = moves[i];
+        uint64_t flips = getFlips(mine, theirs, moveId);
+        batch.moves[i] = moveId;
+        batch.flips[i] = flips;
+        batch.mine[i] = mine | flips | (1ULL << moveId);
+        batch.theirs[i] = theirs & ~flips;
+    }
+    batch.size = count;
+    for (; i % BATCH_LANES != 0; i++) {
+        batch.mine[i] = 0;
+        batch.theirs[i] = 0;
+    }
+}
+
+void batchCounts(const ChildBatch &batch, int mineCount[], int theirsCount[]) {
+    countsKernel(batch, mineCount, theirsCount);
+}
+
+void batchMobility(const ChildBatch &batch, int mobility[]) {
+    mobilityKernel(batch, mobility);
+}
+
+void batchPositional(const ChildBatch &batch, int scores[]) {
+    positionalKernel(batch, scores);
+}
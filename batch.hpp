@@ -0,0 +1,53 @@
+#ifndef __BATCH_H__
+#define __BATCH_H__
+
+#include <cstdint>
+#include "common.hpp"
+#include "board.hpp"
+
+/*
+ * Batched evaluation of all the children of a node.
+ *
+ * The children are written as a structure of arrays, one mask array per
+ * colour, and the kernels below then score them together: with AVX2 four
+ * children share each instruction, with SSE4 two. The widest kernels the
+ * CPU supports are picked when the program starts; the scalar versions give
+ * the same results everywhere else.
+ */
+
+// Children are processed in groups of this many; the arrays are padded to it.
+const int BATCH_LANES = 4;
+
+/*
+ * The positions after each move of a node, from the mover's point of view.
+ */
+struct ChildBatch {
+    alignas(32) uint64_t mine[MAX_MOVES];     // the mover's discs, including the new one
+    alignas(32) uint64_t theirs[MAX_MOVES];   // the opponent's discs left after the flips
+    uint64_t flips[MAX_MOVES];
+    int moves[MAX_MOVES];
+    int size;
+};
+
+enum BatchKernel {
+    BATCH_SCALAR,
+    BATCH_SSE4,
+    BATCH_AVX2
+};
+
+// plays each of the count moves for mine against theirs into batch
+void generateChildren(uint64_t mine, uint64_t theirs, const int moves[], int count, ChildBatch &batch);
+
+// the disc count of each side in each child
+void batchCounts(const ChildBatch &batch, int mineCount[], int theirsCount[]);
+// own minus opponent legal moves in each child, for the mover
+void batchMobility(const ChildBatch &batch, int mobility[]);
+// Board::calcPositionalScore() of each child, for the mover
+void batchPositional(const ChildBatch &batch, int scores[]);
+
+// the kernels in use; selectBatchKernel() returns false if the CPU lacks the requested ones
+BatchKernel getBatchKernel();
+bool selectBatchKernel(BatchKernel kernel);
+const char *batchKernelName(BatchKernel kernel);
+
+#endif
@@ -0,0 +1,211 @@
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <string>
+#include "endgame.hpp"
+#include "eval.hpp"
+#include "probcut.hpp"
+#include "search.hpp"
+using namespace std;
+
+/*
+ * Search benchmark over a fixed set of positions.
+ *
+ * Every position comes with its perfect-play score for the side to move and
+ * all the moves that reach it, found by solving each move exactly when the
+ * set was put together (in the style of the FFO endgame test suite). A
+ * position with at most -e empties is solved with the endgame solver and
+ * checked for both move and score; the others are searched with the
+ * midgame search, to depth -d or within a budget of -n nodes, and checked
+ * for the move. For each position the time, nodes, speed and result are
+ * printed, then the totals.
+ *
+ * The searches run on one thread with a table cleared for every position,
+ * and the leaves use the square weights unless -w says otherwise, so with
+ * -d or -n the nodes and results are the same on every run and machine;
+ * only the times vary. With -j the midgame searches run on a Lazy SMP pool
+ * of that many threads instead, whose nodes are counted over all threads
+ * and vary from run to run; comparing the speed at 1, 2, 4, ... threads
+ * measures how the pool scales.
+ */
+
+typedef chrono::steady_clock BenchClock;
+
+// Transposition table, in MB.
+static const int BENCH_TT_MB = 64;
+
+/*
+ * A position of the set, in the FFO notation: 64 squares a1 .. h8 with X
+ * black, O white and - empty, and X or O to move.
+ */
+struct BenchPosition {
+    const char *name;
+    const char *squares;
+    char toMove;
+    const char *bestMoves;  // every move reaching the score, space-separated
+    int score;              // perfect-play disc margin for the side to move
+};
+
+static const BenchPosition POSITIONS[] = {
+    { "end14a", "-XXXXXX---OOOX--OOOOOXXXOXOXOOX-OXXOOXXOOOXXXXOO-OXXX--OOOOO----", 'X', "a7", -12 },
+    { "end14b", "O-X-O---XOXOO--OXOOOO-OOXOOXOOXOXOXXOX--XXXOXXX-XOXXXX--XXXXXXX-", 'X', "b1 g2", 4 },
+    { "end16a", "-----X--O---OX-O-OO-OXOXXOOOXOXXXOXOOXXXXXXOOXXX-XOXXOO-XXXXXXO-", 'X', "h1", 42 },
+    { "end16b", "-------X-XO----X-XOOOO-XXXOXOOOX-XXXXXXXOOXXOOOXOOOOOOOXX-XXXXXX", 'X', "a5 c1 d1 f2", 12 },
+    { "end18a", "--XXXXXXO-OOOXXX-OOXXXXO--OXXXO---OXXOOX-XOXXXXX--OOOO-X---OOO--", 'X', "h4", 52 },
+    { "end18b", "--XXOX--X-XO-O--XXOOOXOOXOOOOXOO-OOOXOXOOOOOOXOO--OOOOX------O-X", 'X', "h7", 34 },
+    { "end20a", "--O--O--O-OOOO---OOOXOXO-OOXXOO-OOXXOOO---XOOOOO-XOOOO--XOOOOO--", 'X', "h5", 46 },
+    { "end20b", "-XX------XXXX---OXXXXX--OOOOXOX-OOOXOO--OOXOXO--OXOXOX--XXXXXXX-", 'X', "a2 g3 g7", -2 },
+    { "mid22a", "-----O-----X-O-OO-XXXXOXOOXXOO-XOXXOXOOX-XXXXXOX---XOO----XXXXXX", 'X', "h1", 32 },
+    { "mid22b", "--X-XXXO--X-XXO---XXXXXX--OOOOXX---OXOOX--XOOOXX-X--OOXX---OOOOX", 'X', "h2", 4 },
+    { "mid22c", "--OOOOO-O-OOO---OOOXXXX-OOXOXX--OOOXXO--OOOOOO--O-XOOOX---X----X", 'X', "e8 g8", 16 },
+    { "mid24a", "----X-------XXX----XXXXX--XXOOOOXXXXXOOO-XOXOOOO-OXO--OO--OOOO-O", 'X', "e7", -28 },
+    { "mid24b", "--XXX---X-XX----XXXOX---XXXOXXO-XXXXOXX-X-XXOOOO-XOOOO---OOO----", 'X', "h3", -16 },
+    { "mid24c", "OOOOO---O-XXO---O-XXO---OXOOOO--OXXXXO--OOXXXXO-O----XXO----XXXX", 'X', "h6", 10 },
+};
+
+static const int NUM_POSITIONS = sizeof(POSITIONS) / sizeof(POSITIONS[0]);
+
+struct BenchOptions {
+    int depth;
+    long long nodes;        // node budget of a midgame search; 0: search to depth
+    int exactEmpties;
+    int threads;            // of the midgame searches
+    const char *weights;    // nullptr: square weights
+    const char *probCut;    // nullptr: full-width search
+    const char *only;       // run the positions whose name starts with this; nullptr: all
+};
+
+/*
+ * Whether the move is one of the space-separated names in moves.
+ */
+static bool listed(const char *moves, int moveId) {
+    string name = squareName(moveId);
+    string list = string(" ") + moves + " ";
+    return list.find(" " + name + " ") != string::npos;
+}
+
+static void usage(const char *name) {
+    cerr << "usage: " << name << " [-d depth | -n nodes] [-e empties] [-j threads] [-w weights] [-c probcut] [-p name]"
+         << endl
+         << "  -d  depth of the midgame searches (default 10)" << endl
+         << "  -n  node budget of each midgame search instead of a depth" << endl
+         << "  -e  solve positions with this many empties or fewer exactly (default 20)" << endl
+         << "  -j  threads of the midgame searches (default 1)" << endl
+         << "  -w  pattern weights for the midgame searches (default: square weights)" << endl
+         << "  -c  Multi-ProbCut parameters for those weights (default none)" << endl
+         << "  -p  only the positions whose name starts with this" << endl;
+    exit(-1);
+}
+
+int main(int argc, char *argv[]) {
+    BenchOptions options;
+    options.depth = 10;
+    options.nodes = 0;
+    options.exactEmpties = 20;
+    options.threads = 1;
+    options.weights = nullptr;
+    options.probCut = nullptr;
+    options.only = nullptr;
+
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (!strcmp(argv[i], "-d") && hasValue)
+            options.depth = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-n") && hasValue)
+            options.nodes = atoll(argv[++i]);
+        else if (!strcmp(argv[i], "-e") && hasValue)
+            options.exactEmpties = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-j") && hasValue)
+            options.threads = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-w") && hasValue)
+            options.weights = argv[++i];
+        else if (!strcmp(argv[i], "-c") && hasValue)
+            options.probCut = argv[++i];
+        else if (!strcmp(argv[i], "-p") && hasValue)
+            options.only = argv[++i];
+        else
+            usage(argv[0]);
+    }
+    if (options.depth < 1 || options.depth > MAX_SEARCH_DEPTH || options.nodes < 0 || options.threads < 1)
+        usage(argv[0]);
+
+    PatternEval eval;
+    ProbCut probCut;
+    if (options.weights != nullptr && !eval.load(options.weights)) {
+        cerr << "cannot read weights " << options.weights << endl;
+        return 1;
+    }
+    if (options.probCut != nullptr && !probCut.load(options.probCut)) {
+        cerr << "cannot read Multi-ProbCut parameters " << options.probCut << endl;
+        return 1;
+    }
+
+    TranspositionTable tt(BENCH_TT_MB);
+    SearchPool pool(options.threads, &tt);
+    if (options.weights != nullptr)
+        pool.setEvaluation(&eval);
+    if (options.probCut != nullptr)
+        pool.setProbCut(&probCut);
+    EndgameSolver solver(&tt);
+
+    printf("%-8s %3s %6s %10s %12s %8s  %-5s %6s  %s\n",
+           "position", "emp", "depth", "ms", "nodes", "Mnps", "move", "score", "expected");
+    int run = 0, movesRight = 0, solved = 0, scoresRight = 0;
+    long long totalNodes = 0;
+    double totalSeconds = 0;
+    for (int p = 0; p < NUM_POSITIONS; p++) {
+        const BenchPosition &position = POSITIONS[p];
+        if (options.only != nullptr && strncmp(position.name, options.only, strlen(options.only)) != 0)
+            continue;
+
+        char data[64];
+        for (int sq = 0; sq < 64; sq++)
+            data[sq] = position.squares[sq] == 'X' ? 'b' : position.squares[sq] == 'O' ? 'w' : ' ';
+        Board board;
+        board.setBoard(data);
+        Side side = position.toMove == 'X' ? BLACK : WHITE;
+        int empties = 64 - board.countBlack() - board.countWhite();
+
+        int moveId;
+        int score;
+        long long nodes;
+        bool exact = empties <= options.exactEmpties;
+        string depth = "exact";
+        tt.clear();
+        BenchClock::time_point begin = BenchClock::now();
+        if (exact) {
+            score = solver.solveRoot(board, side, moveId);
+            nodes = solver.getNodes();
+        }
+        else {
+            SearchLimits limits;
+            limits.maxDepth = options.nodes > 0 ? MAX_SEARCH_DEPTH : options.depth;
+            limits.maxNodes = options.nodes;
+            score = pool.search(board, side, limits, moveId);
+            nodes = pool.getNodes();
+            depth = to_string(pool.getDepthReached());
+        }
+        double seconds = chrono::duration<double>(BenchClock::now() - begin).count();
+
+        bool moveRight = listed(position.bestMoves, moveId);
+        bool scoreRight = exact && score == position.score;
+        run++;
+        movesRight += moveRight;
+        solved += exact;
+        scoresRight += scoreRight;
+        totalNodes += nodes;
+        totalSeconds += seconds;
+        printf("%-8s %3d %6s %10.1f %12lld %8.2f  %-5s %6d  %s %+d %s\n",
+               position.name, empties, depth.c_str(), seconds * 1000, nodes,
+               seconds > 0 ? nodes / seconds / 1e6 : 0.0, squareName(moveId).c_str(), score,
+               position.bestMoves, position.score,
+               !moveRight ? "WRONG MOVE" : exact && !scoreRight ? "WRONG SCORE" : "ok");
+    }
+
+    printf("%d positions: %d best moves, %d of %d exact scores right; %lld nodes, %.3f s, %.2f Mnps\n",
+           run, movesRight, scoresRight, solved, totalNodes, totalSeconds,
+           totalSeconds > 0 ? totalNodes / totalSeconds / 1e6 : 0.0);
+    return (scoresRight == solved) ? 0 : 1;
+}
@@ -0,0 +1,157 @@
+#ifndef __BITBOARD_H__
+#define __BITBOARD_H__
+
+#include <cstdint>
+
+/*
+ * Bitboard kernels shared by the board and the search.
+ *
+ * A position is held as two 64-bit masks: bit (x + 8*y) is set when the
+ * square (x, y) holds a disc of that colour. The kernels below are written
+ * in terms of the side to move ("player", P) and the other side
+ * ("opponent", O) so that they do not care which colour is which.
+ */
+
+// Opponent discs that may sit inside a horizontal or diagonal run; discs on
+// the a/h files can never be flanked along those directions.
+const uint64_t INNER_FILES = 0x7E7E7E7E7E7E7E7EULL;
+
+/*
+ * Number of set bits in a mask.
+ */
+inline int popCount(uint64_t b) {
+    return __builtin_popcountll(b);
+}
+
+/*
+ * Index of the lowest set bit; b must not be zero.
+ */
+inline int firstSquare(uint64_t b) {
+    return __builtin_ctzll(b);
+}
+
+/*
+ * Board symmetries on masks: flipDiagonal swaps x and y, mirrorHorizontal
+ * maps x to 7 - x and flipVertical maps y to 7 - y.
+ */
+inline uint64_t flipDiagonal(uint64_t b) {
+    uint64_t k;
+    k = 0x5500550055005500ULL & (b ^ (b << 7));
+    b ^= k ^ (k >> 7);
+    k = 0x3333000033330000ULL & (b ^ (b << 14));
+    b ^= k ^ (k >> 14);
+    k = 0x0F0F0F0F00000000ULL & (b ^ (b << 28));
+    b ^= k ^ (k >> 28);
+    return b;
+}
+
+inline uint64_t mirrorHorizontal(uint64_t b) {
+    b = ((b >> 1) & 0x5555555555555555ULL) | ((b & 0x5555555555555555ULL) << 1);
+    b = ((b >> 2) & 0x3333333333333333ULL) | ((b & 0x3333333333333333ULL) << 2);
+    b = ((b >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((b & 0x0F0F0F0F0F0F0F0FULL) << 4);
+    return b;
+}
+
+inline uint64_t flipVertical(uint64_t b) {
+    return __builtin_bswap64(b);
+}
+
+/*
+ * Where square sq ends up under one of the 8 board symmetries: bit 4 of
+ * symmetry swaps x and y, then bit 1 mirrors x and bit 2 mirrors y.
+ */
+inline int symmetricSquare(int sq, int symmetry) {
+    int x = sq % 8;
+    int y = sq / 8;
+    if (symmetry & 4) {
+        int t = x;
+        x = y;
+        y = t;
+    }
+    if (symmetry & 1)
+        x = 7 - x;
+    if (symmetry & 2)
+        y = 7 - y;
+    return x + 8 * y;
+}
+
+/*
+ * Kogge-Stone fill of gen through pro towards higher square ids (shift > 0)
+ * or lower square ids (shift < 0). Returns gen together with every square of
+ * pro reachable from it along the direction.
+ */
+inline uint64_t fillUp(uint64_t gen, uint64_t pro, int shift) {
+    gen |= pro & (gen << shift);
+    pro &= (pro << shift);
+    gen |= pro & (gen << (2 * shift));
+    pro &= (pro << (2 * shift));
+    gen |= pro & (gen << (4 * shift));
+    return gen;
+}
+
+inline uint64_t fillDown(uint64_t gen, uint64_t pro, int shift) {
+    gen |= pro & (gen >> shift);
+    pro &= (pro >> shift);
+    gen |= pro & (gen >> (2 * shift));
+    pro &= (pro >> (2 * shift));
+    gen |= pro & (gen >> (4 * shift));
+    return gen;
+}
+
+/*
+ * Mask of all legal moves for the player P against the opponent O.
+ *
+ * For each of the 8 directions, P is flooded through contiguous opponent
+ * discs; the empty square one step beyond such a run is a legal move.
+ */
+inline uint64_t getMoves(uint64_t P, uint64_t O) {
+    uint64_t empty = ~(P | O);
+    uint64_t inner = O & INNER_FILES;
+    uint64_t moves = 0;
+
+    // East (+1) / west (-1).
+    moves |= ((fillUp(P, inner, 1) & ~P) << 1);
+    moves |= ((fillDown(P, inner, 1) & ~P) >> 1);
+    // South (+8) / north (-8): no file wrap possible.
+    moves |= ((fillUp(P, O, 8) & ~P) << 8);
+    moves |= ((fillDown(P, O, 8) & ~P) >> 8);
+    // Diagonals (+9/-9 and +7/-7).
+    moves |= ((fillUp(P, inner, 9) & ~P) << 9);
+    moves |= ((fillDown(P, inner, 9) & ~P) >> 9);
+    moves |= ((fillUp(P, inner, 7) & ~P) << 7);
+    moves |= ((fillDown(P, inner, 7) & ~P) >> 7);
+
+    return moves & empty;
+}
+
+/*
+ * Mask of the opponent discs flipped when P plays on square sq. Returns 0 if
+ * the move flips nothing (i.e. it is not a legal move, provided sq is empty).
+ */
+inline uint64_t getFlips(uint64_t P, uint64_t O, int sq) {
+    uint64_t m = 1ULL << sq;
+    uint64_t inner = O & INNER_FILES;
+    uint64_t flips = 0;
+    uint64_t run;
+
+    run = fillUp(m, inner, 1) & ~m;
+    if ((run << 1) & P) flips |= run;
+    run = fillDown(m, inner, 1) & ~m;
+    if ((run >> 1) & P) flips |= run;
+    run = fillUp(m, O, 8) & ~m;
+    if ((run << 8) & P) flips |= run;
+    run = fillDown(m, O, 8) & ~m;
+    if ((run >> 8) & P) flips |= run;
+    run = fillUp(m, inner, 9) & ~m;
+    if ((run << 9) & P) flips |= run;
+    run = fillDown(m, inner, 9) & ~m;
+    if ((run >> 9) & P) flips |= run;
+    run = fillUp(m, inner, 7) & ~m;
+    if ((run << 7) & P) flips |= run;
+    run = fillDown(m, inner, 7) & ~m;
+    if ((run >> 7) & P) flips |= run;
+
+    return flips;
+}
+
+#endif
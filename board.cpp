@@ -1,15 +1,15 @@
 #include "board.hpp"
+#include "search.hpp"
+#include "batch.hpp"
 
 /*
  * Make a standard 8x8 othello board and initialize it to the standard setup.
  */
 Board::Board() {
-    taken.set(3 + 8 * 3);
-    taken.set(3 + 8 * 4);
-    taken.set(4 + 8 * 3);
-    taken.set(4 + 8 * 4);
-    black.set(4 + 8 * 3);
-    black.set(3 + 8 * 4);
+    black = (1ULL << (4 + 8 * 3)) | (1ULL << (3 + 8 * 4));
+    white = (1ULL << (3 + 8 * 3)) | (1ULL << (4 + 8 * 4));
+    hash = calcHash();
+    undoTop = 0;
 }
 
 /*
@@ -24,25 +24,41 @@ Board::~Board() {
 Board *Board::copy() {
     Board *newBoard = new Board();
     newBoard->black = black;
-    newBoard->taken = taken;
+    newBoard->white = white;
+    newBoard->hash = hash;
     return newBoard;
 }
 
 bool Board::occupied(int x, int y) {
-    return taken[x + 8*y];
+    return ((black | white) >> (x + 8*y)) & 1;
 }
 
 bool Board::get(Side side, int x, int y) {
-    return occupied(x, y) && (black[x + 8*y] == (side == BLACK));
+    return (getMask(side) >> (x + 8*y)) & 1;
 }
 
 void Board::set(Side side, int x, int y) {
-    taken.set(x + 8*y);
-    black.set(x + 8*y, side == BLACK);
+    uint64_t bit = 1ULL << (x + 8*y);
+    if (side == BLACK) {
+        black |= bit;
+        white &= ~bit;
+    } else {
+        white |= bit;
+        black &= ~bit;
+    }
+    hash = calcHash();
 }
 
-bool Board::onBoard(int x, int y) {
-    return(0 <= x && x < 8 && 0 <= y && y < 8);
+/*
+ * Zobrist key of the discs, computed from scratch.
+ */
+uint64_t Board::calcHash() {
+    uint64_t key = 0;
+    for (uint64_t b = black; b; b &= b - 1)
+        key ^= ZOBRIST_DISC[BLACK][firstSquare(b)];
+    for (uint64_t b = white; b; b &= b - 1)
+        key ^= ZOBRIST_DISC[WHITE][firstSquare(b)];
+    return key;
 }
 
 
@@ -58,87 +74,7 @@ bool Board::isDone() {
  * Returns true if there are legal moves for the given side.
  */
 bool Board::hasMoves(Side side) {
-    for (int i = 0; i < 8; i++) {
-        for (int j = 0; j < 8; j++) {
-            Move move(i, j);
-            if (checkMove(&move, side)) return true;
-        }
-    }
-    return false;
-}
-
-/*
- * Returns true if a move is legal for the given side; false otherwise.
- */
-bool Board::checkMove(Move *m, Side side) {
-    // Passing is only legal if you have no moves.
-    if (m == nullptr) return !hasMoves(side);
-
-    int X = m->getX();
-    int Y = m->getY();
-
-    // Make sure the square hasn't already been taken.
-    if (occupied(X, Y)) return false;
-
-    Side other = (side == BLACK) ? WHITE : BLACK;
-    for (int dx = -1; dx <= 1; dx++) {
-        for (int dy = -1; dy <= 1; dy++) {
-            if (dy == 0 && dx == 0) continue;
-
-            // Is there a capture in that direction?
-            int x = X + dx;
-            int y = Y + dy;
-            if (onBoard(x, y) && get(other, x, y)) {
-                do {
-                    x += dx;
-                    y += dy;
-                } while (onBoard(x, y) && get(other, x, y));
-
-                if (onBoard(x, y) && get(side, x, y)) return true;
-            }
-        }
-    }
-    return false;
-}
-
-/*
- * Modifies the board to reflect the specified move.
- */
-void Board::doMove(Move *m, Side side) {
-    // A nullptr move means pass.
-    if (m == nullptr) return;
-
-    // Ignore if move is invalid.
-    if (!checkMove(m, side)) return;
-
-    int X = m->getX();
-    int Y = m->getY();
-    Side other = (side == BLACK) ? WHITE : BLACK;
-    for (int dx = -1; dx <= 1; dx++) {
-        for (int dy = -1; dy <= 1; dy++) {
-            if (dy == 0 && dx == 0) continue;
-
-            int x = X;
-            int y = Y;
-            do {
-                x += dx;
-                y += dy;
-            } while (onBoard(x, y) && get(other, x, y));
-
-            if (onBoard(x, y) && get(side, x, y)) {
-                x = X;
-                y = Y;
-                x += dx;
-                y += dy;
-                while (onBoard(x, y) && get(other, x, y)) {
-                    set(side, x, y);
-                    x += dx;
-                    y += dy;
-                }
-            }
-        }
-    }
-    set(side, X, Y);
+    return getLegalMoveMask(side) != 0;
 }
 
 /*
@@ -152,14 +88,14 @@ int Board::count(Side side) {
  * Current count of black stones.
  */
 int Board::countBlack() {
-    return black.count();
+    return popCount(black);
 }
 
 /*
  * Current count of white stones.
  */
 int Board::countWhite() {
-    return taken.count() - black.count();
+    return popCount(white);
 }
 
 /*
@@ -167,34 +103,26 @@ int Board::countWhite() {
  * piece and 'b' indicates a black piece. Mainly for testing purposes.
  */
 void Board::setBoard(char data[]) {
-    taken.reset();
-    black.reset();
+    black = 0;
+    white = 0;
     for (int i = 0; i < 64; i++) {
         if (data[i] == 'b') {
-            taken.set(i);
-            black.set(i);
+            black |= 1ULL << i;
         } if (data[i] == 'w') {
-            taken.set(i);
+            white |= 1ULL << i;
         }
     }
+    hash = calcHash();
 }
 
 
 /*
- * Helper function: to find all the legal moves for the specified side using checkMove()
+ * Helper function: to find all the legal moves for the specified side from the legal-move mask
  */
 vector<int> Board::getLegalMoveIds(Side side) {
-    vector<int> legalMoveIds;
-    for (int x = 0; x < 8; ++x)
-    {
-        for (int y = 0; y < 8; ++y)
-        {
-            Move move(x, y);
-            if (checkMove(&move, side))
-                legalMoveIds.push_back(x + 8*y);  // trace the moveId for a legal move
-        }
-    }
-    return legalMoveIds;
+    MoveList list;
+    getLegalMoves(side, list);
+    return vector<int>(list.moves, list.moves + list.size);
 }
 
 /*
@@ -212,24 +140,17 @@ int Board::getBestMoveId(Side side, vector<int>& legalMoveIdVec)
     int bestId = -1;
     for (int moveId: legalMoveIdVec)
     {
-        // copy the current board to a simulated board for a next move
-        Board *nextBoard = copy();
-
-        int x = moveId%8;
-        int y = moveId/8;
-        Move nextMove(x, y);
-        nextBoard->doMove(&nextMove, side);
-        //int score = nextBoard->calcSimpleScore(side);
-        int score = nextBoard->calcHeuristicScore(side, nextMove);
-        //if (score != score0)
-        //    cerr << "Something fishy: (score0, score)=(" << score0 << "," << score << ")" << endl;
+        // play the move in place on this board to simulate it
+        Move nextMove(moveId%8, moveId/8);
+        makeMove(moveId, side);
+        //int score = calcSimpleScore(side);
+        int score = calcHeuristicScore(side, nextMove);
+        undoMove();  // take back the simulated move
         if (score > bestScore)
         {
             bestScore = score;
             bestId = moveId;
         }
-
-        delete nextBoard;  // clean up the simulated board
     }
 
     return bestId;
@@ -247,19 +168,48 @@ int Board::calcSimpleScore(Side side)
 }
 
 
+/*
+ * Helper function: the weight the heuristic scores give to the discs of the
+ * side that just played on a square: corners triple them, the squares next
+ * to a corner turn them negative. Worked out once, at compile time.
+ */
+struct SquareTable {
+    int value[64];
+};
+
+static constexpr SquareTable makeSquareMultipliers()
+{
+    SquareTable table = {};
+    for (int sq = 0; sq < 64; sq++)
+    {
+        int x = sq % 8;
+        int y = sq / 8;
+        if ( (x==0 || x==7) && (y==0 || y==7) )  // corners
+            table.value[sq] = 3;
+        else if ( (x<=1 || x >=6) && (y<=1 || y >= 6))  // corner-adjacent squares
+            table.value[sq] = -3;
+        else
+            table.value[sq] = 1;
+    }
+    return table;
+}
+
+static constexpr SquareTable SQUARE_MULTIPLIER = makeSquareMultipliers();
+
+// the multiplier of a move given by coordinates, which may be off the board
+static int squareMultiplier(const Move &move)
+{
+    PackedMove square(move.x, move.y);
+    return square.onBoard() ? SQUARE_MULTIPLIER.value[square.id] : 1;
+}
+
 /*
  * Helper function: to get the current score using a heuristic scheme (position-weighted):
  *                  score = (# stones the given side has) - (# stones the opponent side has)
  */
 int Board::calcHeuristicScore(Side side, Move &testMove)
 {
-    int x = testMove.x;
-    int y = testMove.y;
-    int multiplier = 1;
-    if ( (x==0 || x==7) && (y==0 || y==7) )  // corners
-        multiplier = 3;
-    else if ( (x<=1 || x >=6) && (y<=1 || y >= 6))  // corner-adjacent squares + corners
-        multiplier = -3;
+    int multiplier = squareMultiplier(testMove);
 
     return side==BLACK ? multiplier*countBlack()-countWhite() : multiplier*countWhite()-countBlack();
     //return multiplier*calcSimpleScore(side);
@@ -272,14 +222,15 @@ int Board::calcHeuristicScore(Side side, Move &testMove)
  */
 int Board::calcHeuristicScore4MinMax(Side side, Side testSide, Move &testMove)
 {
-    int x = testMove.x;
-    int y = testMove.y;
-    int multiplier = 1;
-    if ( (x==0 || x==7) && (y==0 || y==7) )  // corners
-        multiplier = 3;
-    else if ( (x<=1 || x >=6) && (y<=1 || y >= 6))  // corner-adjacent squares + corners
-        multiplier = -3;
+    int multiplier = squareMultiplier(testMove);
+    if (side == BLACK)
+        return testSide == BLACK ? heuristicScore4MinMax<BLACK, BLACK>(multiplier) : heuristicScore4MinMax<BLACK, WHITE>(multiplier);
+    return testSide == BLACK ? heuristicScore4MinMax<WHITE, BLACK>(multiplier) : heuristicScore4MinMax<WHITE, WHITE>(multiplier);
+}
 
+template <Side side, Side testSide>
+int Board::heuristicScore4MinMax(int multiplier)
+{
     // testSide determines which count will be updated by the multiplier.
     int blackCount = testSide==BLACK ? multiplier*countBlack() : countBlack();
     int whiteCount = testSide==WHITE ? multiplier*countWhite() : countWhite();
@@ -297,13 +248,13 @@ int Board::calcHeuristicScore4MinMax(Side side, Side testSide, Move &testMove)
  *  2. Based on a score scheme to calculate a score for each legal move, find the move id with the best (max) score.
  *  3. return the move with the best score as the next move
  *
- * This function will return nullptr if no legal move can be found
+ * This function will return a pass if no legal move can be found
  */
-Move *Board::getBestNextMove(Side side)
+PackedMove Board::bestNextMove(Side side)
 {
-    vector<int> legalMoveIdVec = getLegalMoveIds(side);
-    if (legalMoveIdVec.size() < 1)  // no legal move to explore
-        return nullptr;
+    MoveList legalMoves;
+    if (getLegalMoves(side, legalMoves) < 1)  // no legal move to explore
+        return PackedMove::pass();
 
     // string legalMovesString("[");
     // string scoresString("]");
@@ -313,16 +264,17 @@ Move *Board::getBestNextMove(Side side)
     // scoresSS << "[";
     int bestScore = INT_MIN;
     int bestId = -1;
-    for (int moveId: legalMoveIdVec)
+    // all children at once: calcHeuristicScore() needs only their disc counts
+    ChildBatch children;
+    generateChildren(getMask(side), getMask(side==BLACK ? WHITE : BLACK), legalMoves.moves, legalMoves.size, children);
+    int mineCount[MAX_MOVES];
+    int theirsCount[MAX_MOVES];
+    batchCounts(children, mineCount, theirsCount);
+    for (int i = 0; i < children.size; i++)
     {
-        // copy the current board to a simulated board for a test move
-        Board *testBoard = copy();
-
-        Move testMove(moveId%8, moveId/8);
-        testBoard->doMove(&testMove, side);
-        //int score = testBoard->calcSimpleScore(side);
-        int score = testBoard->calcHeuristicScore(side, testMove);
-        // legalMovesSS << "(" << testMove.x << "," << testMove.y << "),";
+        int moveId = children.moves[i];
+        int score = SQUARE_MULTIPLIER.value[moveId] * mineCount[i] - theirsCount[i];
+        // legalMovesSS << "(" << moveId%8 << "," << moveId/8 << "),";
         // scoresSS << score << "," ;
 
         if (score > bestScore)
@@ -330,8 +282,6 @@ Move *Board::getBestNextMove(Side side)
             bestScore = score;
             bestId = moveId;
         }
-
-        delete testBoard;  // clean up the simulated board
     }
     // legalMovesString += "]";
     // scoresString += "]";
@@ -344,13 +294,11 @@ Move *Board::getBestNextMove(Side side)
     if (bestId < 0)
     {
         cerr << "getBestNextMove(): fishy score calculation: no score exists for all legal moves of size="
-            << legalMoveIdVec.size() << endl;
-        return nullptr;
+            << legalMoves.size << endl;
+        return PackedMove::pass();
     }
 
-    Move *nextMove = new Move(bestId%8, bestId/8);
-
-    return nextMove;
+    return PackedMove(bestId);
 }
 
 
@@ -360,13 +308,13 @@ Move *Board::getBestNextMove(Side side)
  *  2. Based on the minimax decision tree to find the move id with the best (max) score.
  *  3. return the move with the best score as the next move
  *
- * This function will return nullptr if no legal move can be found
+ * This function will return a pass if no legal move can be found
  */
-Move *Board::getMiniMaxMove(Side side)
+PackedMove Board::miniMaxMove(Side side)
 {
-    vector<int> legalMoveIdVec = getLegalMoveIds(side);
-    if (legalMoveIdVec.size() < 1)  // no legal move to explore
-        return nullptr;
+    MoveList legalMoves;
+    if (getLegalMoves(side, legalMoves) < 1)  // no legal move to explore
+        return PackedMove::pass();
 
     // string legalMovesString("[");
     // string scoresString("]");
@@ -377,17 +325,15 @@ Move *Board::getMiniMaxMove(Side side)
     int bestScore = INT_MIN;
     int bestId = -1;
     // for each possible first-ply move
-    for (int moveId: legalMoveIdVec)
+    for (int moveId: legalMoves)
     {
-        // copy the current board to a simulated board for a test move
-        Board *testBoard = copy();
-
+        // play the test move in place on this board to simulate it
         Move testMove(moveId%8, moveId/8);
-        testBoard->doMove(&testMove, side);
-        //int score = testBoard->calcSimpleScore(side);
+        makeMove(moveId, side);
+        //int score = calcSimpleScore(side);
         int score;
         // calculating the second-ply scores
-        score = testBoard->calcMinScore(side, side==BLACK ? WHITE: BLACK);
+        score = calcMinScore(side, side==BLACK ? WHITE: BLACK);
 
 
         // legalMovesSS << "(" << testMove.x << "," << testMove.y << "),";
@@ -399,7 +345,7 @@ Move *Board::getMiniMaxMove(Side side)
             bestId = moveId;
         }
 
-        delete testBoard;  // clean up the simulated board
+        undoMove();  // take back the simulated move
     }
     // legalMovesString += "]";
     // scoresString += "]";
@@ -412,20 +358,18 @@ Move *Board::getMiniMaxMove(Side side)
     if (bestId < 0)
     {
         cerr << "getBestNextMove(): fishy score calculation: no score exists for all legal moves of size="
-            << legalMoveIdVec.size() << endl;
-        return nullptr;
+            << legalMoves.size << endl;
+        return PackedMove::pass();
     }
 
-    Move *nextMove = new Move(bestId%8, bestId/8);
-
-    return nextMove;
+    return PackedMove(bestId);
 }
 
 // Just for second-ply calculations
 int Board::calcMinScore(Side mySide, Side testSide)
 {
-    vector<int> legalMoveIdVec = getLegalMoveIds(testSide);
-    if (legalMoveIdVec.size() < 1)  // no legal move to explore
+    MoveList legalMoves;
+    if (getLegalMoves(testSide, legalMoves) < 1)  // no legal move to explore
         return INT_MAX;  // use the INT_MAX to mean a disconnected path
 
 
@@ -434,21 +378,27 @@ int Board::calcMinScore(Side mySide, Side testSide)
     // set to false to use "simpleheuristic" (ie. difference) to agree with the testminimax result.
     bool useHeuristic = true;
 
-    for (int moveId: legalMoveIdVec)
-    {
-        // copy the current board to a simulated board for a test move
-        Board *testBoard = copy();
+    // all replies at once; the scores below are calcHeuristicScore4MinMax() and
+    // calcSimpleScore() worked out from the disc counts of each child
+    ChildBatch children;
+    generateChildren(getMask(testSide), getMask(testSide==BLACK ? WHITE : BLACK), legalMoves.moves, legalMoves.size, children);
+    int testCount[MAX_MOVES];
+    int otherCount[MAX_MOVES];
+    batchCounts(children, testCount, otherCount);
 
-        Move testMove(moveId%8, moveId/8);
-        testBoard->doMove(&testMove, testSide);   // move is determined by testSide
-        // int score = testBoard->calcMiniScore(mySide, testSide==BLACK?WHITE:BLACK, testMove, lookAheadLevel, currLevel+1);   // score is calculated for mySide
-        int score = useHeuristic? testBoard->calcHeuristicScore4MinMax(mySide, testSide, testMove) : testBoard->calcSimpleScore(mySide); // score is calculated for mySide
+    for (int i = 0; i < children.size; i++)
+    {
+        int moveId = children.moves[i];
+        int multiplier = useHeuristic ? SQUARE_MULTIPLIER.value[moveId] : 1;
+        // score is calculated for mySide
+        int score = multiplier * testCount[i] - otherCount[i];
+        if (mySide != testSide)
+            score = otherCount[i] - multiplier * testCount[i];
         if (score < worstScore)
         {
             worstScore = score;
             // worstId = moveId;
         }
-        delete testBoard;  // clean up the simulated board
     }
 
     return worstScore;
@@ -462,13 +412,13 @@ int Board::calcMinScore(Side mySide, Side testSide)
  *  2. Based on the minimax decision tree to find the move id with the best (max) score.
  *  3. return the move with the best score as the next move
  *
- * This function will return nullptr if no legal move can be found
+ * This function will return a pass if no legal move can be found
  */
-Move *Board::getMiniMaxMove(Side mySide, int lookAheadLevel)
+PackedMove Board::miniMaxMove(Side mySide, int lookAheadLevel)
 {
-    vector<int> legalMoveIdVec = getLegalMoveIds(mySide);
-    if (legalMoveIdVec.size() < 1)  // no legal move to explore
-        return nullptr;
+    MoveList legalMoves;
+    if (getLegalMoves(mySide, legalMoves) < 1)  // no legal move to explore
+        return PackedMove::pass();
 
     // string legalMovesString("[");
     // string scoresString("]");
@@ -478,16 +428,15 @@ Move *Board::getMiniMaxMove(Side mySide, int lookAheadLevel)
     // scoresSS << "[";
     int bestScore = INT_MIN;
     int bestId = -1;
-    for (int moveId: legalMoveIdVec)
+    for (int moveId: legalMoves)
     {
-        // copy the current board to a simulated board for a test move
-        Board *testBoard = copy();
-
-        Move testMove(moveId%8, moveId/8);
-        testBoard->doMove(&testMove, mySide);
-        //int score = testBoard->calcSimpleScore(side);
+        int multiplier = SQUARE_MULTIPLIER.value[moveId];
+        // play the test move in place on this board to simulate it
+        makeMove(moveId, mySide);
+        //int score = calcSimpleScore(side);
         // MAJOR difference between 2-ply vs n-ply calculations !! 
-        int score = testBoard->calcMiniMaxScore(mySide, mySide==BLACK ? WHITE: BLACK, testMove, lookAheadLevel, 1);
+        int score = mySide == BLACK ? miniMaxScore<BLACK, WHITE>(multiplier, lookAheadLevel, 1)
+                                    : miniMaxScore<WHITE, BLACK>(multiplier, lookAheadLevel, 1);
 
         // legalMovesSS << "(" << testMove.x << "," << testMove.y << "),";
         // scoresSS << score << "," ;
@@ -498,7 +447,7 @@ Move *Board::getMiniMaxMove(Side mySide, int lookAheadLevel)
             bestId = moveId;
         }
 
-        delete testBoard;  // clean up the simulated board
+        undoMove();  // take back the simulated move
     }
     // legalMovesString += "]";
     // scoresString += "]";
@@ -511,29 +460,43 @@ Move *Board::getMiniMaxMove(Side mySide, int lookAheadLevel)
     if (bestId < 0)
     {
         cerr << "getBestNextMove(): fishy score calculation: no score exists for all legal moves of size="
-            << legalMoveIdVec.size() << endl;
-        return nullptr;
+            << legalMoves.size << endl;
+        return PackedMove::pass();
     }
 
-    Move *nextMove = new Move(bestId%8, bestId/8);
-
-    return nextMove;
+    return PackedMove(bestId);
 }
 
 
 int Board::calcMiniMaxScore(Side mySide, Side testSide, Move &testMove, int lookAheadLevel, int currLevel)
+{
+    int multiplier = squareMultiplier(testMove);
+    if (mySide == BLACK)
+        return testSide == BLACK ? miniMaxScore<BLACK, BLACK>(multiplier, lookAheadLevel, currLevel)
+                                 : miniMaxScore<BLACK, WHITE>(multiplier, lookAheadLevel, currLevel);
+    return testSide == BLACK ? miniMaxScore<WHITE, BLACK>(multiplier, lookAheadLevel, currLevel)
+                             : miniMaxScore<WHITE, WHITE>(multiplier, lookAheadLevel, currLevel);
+}
+
+/*
+ * calcMiniMaxScore() with both sides fixed at compile time; the recursion
+ * alternates between the two instantiations for mySide. The last move is
+ * given by the multiplier of its square.
+ */
+template <Side mySide, Side testSide>
+int Board::miniMaxScore(int lastMultiplier, int lookAheadLevel, int currLevel)
 {
     // Base case 1: when lookAheadLevel is reached, just return the heuristic(or simple) score
     if (currLevel >= lookAheadLevel)
-        return calcHeuristicScore4MinMax(mySide, testSide, testMove);  // calcSimpleScore(mySide);    // score is calculated for mySide
+        return heuristicScore4MinMax<mySide, testSide>(lastMultiplier);  // calcSimpleScore(mySide);    // score is calculated for mySide
 
     // Base case 2: or when no more legal move available; just return INT_MAX as a token for a terminal path
     // a. if testSide == mySide; then it is a max level (as we want to find the best score for ourselves)
     // b. if testSide != mySide; then it is a min level (as we want to find the worst score for ourselves)
 
-    bool isMinLevel = (testSide != mySide);
-    vector<int> legalMoveIdVec = getLegalMoveIds(testSide);
-    if (legalMoveIdVec.size() < 1)  // no legal move to explore
+    const bool isMinLevel = (testSide != mySide);
+    MoveList legalMoves;
+    if (getLegalMoves<testSide>(legalMoves) < 1)  // no legal move to explore
         return isMinLevel? INT_MAX : INT_MIN;  // use the INT_MAX to mean a disconnected path
 
     int minScore = INT_MAX;
@@ -541,14 +504,11 @@ int Board::calcMiniMaxScore(Side mySide, Side testSide, Move &testMove, int look
     int maxScore = INT_MIN;
     //int maxId = -1;
 
-    for (int moveId: legalMoveIdVec)
+    for (int moveId: legalMoves)
     {
-        // copy the current board to a simulated board for a test move
-        Board *testBoard = copy();
-
-        Move testMove(moveId%8, moveId/8);
-        testBoard->doMove(&testMove, testSide);   // move is determined by testSide
-        int score = testBoard->calcMiniMaxScore(mySide, testSide==BLACK?WHITE:BLACK, testMove, lookAheadLevel, currLevel+1);   // score is calculated for mySide
+        // play the test move in place on this board to simulate it
+        makeMove<testSide>(moveId);   // move is determined by testSide
+        int score = miniMaxScore<mySide, opponentOf(testSide)>(SQUARE_MULTIPLIER.value[moveId], lookAheadLevel, currLevel+1);   // score is calculated for mySide
         if (isMinLevel)
         {
             if (score < minScore)
@@ -565,9 +525,48 @@ int Board::calcMiniMaxScore(Side mySide, Side testSide, Move &testMove, int look
                 // maxId = moveId;
             }
         }
-        delete testBoard;  // clean up the simulated board
+        undoMove<testSide>();  // take back the simulated move
     }
 
     return isMinLevel? minScore : maxScore;
 }
 
+
+
+/*
+ * Helper function: to get a score for the side to move that does not depend on the last move:
+ *                  score = (sum of square weights of own stones) - (sum for the opponent's stones)
+ *                          + MOBILITY_WEIGHT * ((# own legal moves) - (# opponent legal moves))
+ * Used at the leaves of the alpha-beta search.
+ */
+int Board::calcPositionalScore(Side side)
+{
+    uint64_t mine = getMask(side);
+    uint64_t theirs = getMask(side == BLACK ? WHITE : BLACK);
+
+    int score = 0;
+    for (uint64_t b = mine; b; b &= b - 1)
+        score += SQUARE_WEIGHTS[firstSquare(b)];
+    for (uint64_t b = theirs; b; b &= b - 1)
+        score -= SQUARE_WEIGHTS[firstSquare(b)];
+
+    int mobility = popCount(getMoves(mine, theirs)) - popCount(getMoves(theirs, mine));
+    return score + MOBILITY_WEIGHT * mobility;
+}
+
+
+/*
+ * Helper function: to find the best legal move with a negamax alpha-beta search (PVS)
+ *  1. Search every legal move depth plies deep, pruning lines that cannot change the result.
+ *     Passes hand the turn over, and finished games are scored exactly.
+ *  2. return the move with the best score as the next move
+ *
+ * This function will return a pass if no legal move can be found
+ */
+PackedMove Board::alphaBetaMove(Side side, int depth)
+{
+    Search search(*this);
+    int bestId;
+    search.searchRoot(side, depth, bestId);
+    return PackedMove(bestId);
+}
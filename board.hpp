@@ -1,25 +1,83 @@
 #ifndef __BOARD_H__
 #define __BOARD_H__
 
-#include <bitset>
+#include <cstdint>
 #include <vector>
 #include <climits>
 #include <iostream>
 #include "common.hpp"
+#include "bitboard.hpp"
+#include "zobrist.hpp"
 
 
 using namespace std;
 
+// No position has more legal moves than it has squares.
+const int MAX_MOVES = 64;
+// Deepest line the undo stack can hold: 60 moves plus the passes in between.
+const int MAX_PLY = 128;
+
+// Square weights and the weight of one legal move of mobility advantage used
+// by calcPositionalScore(); they also seed the default pattern weights.
+// Corners are worth the most, the X- and C-squares that give a corner away
+// are penalised.
+constexpr int SQUARE_WEIGHTS[64] = {
+    100, -20,  10,   5,   5,  10, -20, 100,
+    -20, -50,  -2,  -2,  -2,  -2, -50, -20,
+     10,  -2,   1,   1,   1,   1,  -2,  10,
+      5,  -2,   1,   0,   0,   1,  -2,   5,
+      5,  -2,   1,   0,   0,   1,  -2,   5,
+     10,  -2,   1,   1,   1,   1,  -2,  10,
+    -20, -50,  -2,  -2,  -2,  -2, -50, -20,
+    100, -20,  10,   5,   5,  10, -20, 100
+};
+const int MOBILITY_WEIGHT = 5;
+
+/*
+ * A fixed-size list of legal move ids (x + 8*y); lives on the caller's stack.
+ */
+struct MoveList {
+    int moves[MAX_MOVES];
+    int size;
+
+    int *begin() { return moves; }
+    int *end() { return moves + size; }
+};
+
+/*
+ * What makeMove() changed, so that undoMove() can restore it.
+ */
+struct UndoRecord {
+    uint64_t flips;
+    uint64_t hash;
+    int moveId;
+    Side side;
+};
+
 class Board {
 
 private:
-    bitset<64> black;
-    bitset<64> taken;
+    // one mask per colour; a square is taken if it is set in either
+    uint64_t black;
+    uint64_t white;
+    // Zobrist key of the discs, kept up to date by every move
+    uint64_t hash;
+
+    // make/unmake history; only used by makeMove() and undoMove()
+    UndoRecord undoStack[MAX_PLY];
+    int undoTop;
 
     bool occupied(int x, int y);
     bool get(Side side, int x, int y);
     void set(Side side, int x, int y);
-    bool onBoard(int x, int y);
+    uint64_t calcHash();
+
+    template <Side side> uint64_t &discs() { return side == BLACK ? black : white; }
+    template <Side side> void placeDisc(int moveId, uint64_t flips);
+
+    // the minimax scores with both sides known at compile time
+    template <Side side, Side testSide> int heuristicScore4MinMax(int multiplier);
+    template <Side mySide, Side testSide> int miniMaxScore(int lastMultiplier, int lookAheadLevel, int currLevel);
 
 public:
     Board();
@@ -28,19 +86,47 @@ public:
 
     bool isDone();
     bool hasMoves(Side side);
-    bool checkMove(Move *m, Side side);
-    void doMove(Move *m, Side side);
+    bool checkMove(PackedMove m, Side side) { return side == BLACK ? checkMove<BLACK>(m) : checkMove<WHITE>(m); }
+    void doMove(PackedMove m, Side side) { side == BLACK ? doMove<BLACK>(m) : doMove<WHITE>(m); }
+    // the framework's forms of the two above; nullptr is a pass
+    bool checkMove(Move *m, Side side) { return checkMove(PackedMove::of(m), side); }
+    void doMove(Move *m, Side side) { doMove(PackedMove::of(m), side); }
     int count(Side side);
     int countBlack();
     int countWhite();
 
     void setBoard(char data[]);
 
+    // bitboard accessors used by the search
+    uint64_t getMask(Side side) { return side == BLACK ? black : white; }
+    uint64_t getLegalMoveMask(Side side) { return side == BLACK ? getLegalMoveMask<BLACK>() : getLegalMoveMask<WHITE>(); }
+    // Zobrist key of the position with the given side to move
+    uint64_t getHash(Side toMove) { return toMove == BLACK ? hash : hash ^ ZOBRIST_SIDE; }
+
+    // in-place move application for the search; moveId must be legal or PASS
+    uint64_t makeMove(int moveId, Side side) { return side == BLACK ? makeMove<BLACK>(moveId) : makeMove<WHITE>(moveId); }
+    void undoMove() { undoStack[undoTop - 1].side == BLACK ? undoMove<BLACK>() : undoMove<WHITE>(); }
+
+    // The kernels above with the side fixed at compile time, so that each
+    // colour gets its own code without colour tests; the forms taking a Side
+    // dispatch into these. Hot loops that know their side call them directly.
+    template <Side side> uint64_t getMask() const { return side == BLACK ? black : white; }
+    template <Side side> uint64_t getLegalMoveMask() const { return getMoves(getMask<side>(), getMask<opponentOf(side)>()); }
+    template <Side side> uint64_t getHash() const { return side == BLACK ? hash : hash ^ ZOBRIST_SIDE; }
+    template <Side side> int getLegalMoves(MoveList &list) const;
+    template <Side side> bool checkMove(PackedMove m) const;
+    template <Side side> void doMove(PackedMove m);
+    template <Side side> uint64_t makeMove(int moveId);
+    // takes back the last makeMove(), which side must have made
+    template <Side side> void undoMove();
+
     // helper functions
 
 
     // a helper function to return all legal moveId for a side
     vector<int> getLegalMoveIds(Side side);
+    // the same moves, written into a caller-owned fixed array instead
+    int getLegalMoves(Side side, MoveList &list) { return side == BLACK ? getLegalMoves<BLACK>(list) : getLegalMoves<WHITE>(list); }
 
     // a helper function to return the best moveId given all the legal move for the side
     int getBestMoveId(Side side, vector<int>& legalMoveIdVec);
@@ -51,16 +137,113 @@ public:
     // a helper function to calculate a position-weighted heuristic score for the MiniMax tree
     int calcHeuristicScore4MinMax(Side side, Side testSide, Move &testMove);
     // a helper function to find the best legal move with from all legal moves supporting heuristic and minimax decision tree
-    Move *getBestNextMove(Side side);
+    PackedMove bestNextMove(Side side);
+    Move *getBestNextMove(Side side) { return bestNextMove(side).toMove(); }
     // a helper function to find the best legal move with from all legal moves using 2-ply minimax decision tree
-    Move *getMiniMaxMove(Side side);
+    PackedMove miniMaxMove(Side side);
+    Move *getMiniMaxMove(Side side) { return miniMaxMove(side).toMove(); }
     // a helper function to calculate a mini score (used for the second-ply calculations)
     int calcMinScore(Side mySide, Side testSide);
     // a helper function to find the best legal move with from all legal moves using n-ply minimax decision tree
-    Move *getMiniMaxMove(Side mySide, int lookAheadLevel);
+    PackedMove miniMaxMove(Side mySide, int lookAheadLevel);
+    Move *getMiniMaxMove(Side mySide, int lookAheadLevel) { return miniMaxMove(mySide, lookAheadLevel).toMove(); }
     // a helper function to calculate a min/max score for multiple-ply
     int calcMiniMaxScore(Side mySide, Side testSide, Move &testMove, int lookAheadLevel, int currLevel);
+    // a helper function to calculate a square-weighted and mobility score, independent of the last move
+    int calcPositionalScore(Side side);
+    // a helper function to find the best legal move using a negamax alpha-beta (PVS) search of the given depth
+    PackedMove alphaBetaMove(Side side, int depth);
+    Move *getAlphaBetaMove(Side side, int depth) { return alphaBetaMove(side, depth).toMove(); }
 
 };
 
+/*
+ * Puts a disc of the given side on moveId and turns over the flipped discs,
+ * updating the Zobrist key on the way.
+ */
+template <Side side>
+inline void Board::placeDisc(int moveId, uint64_t flips) {
+    discs<side>() |= flips | (1ULL << moveId);
+    discs<opponentOf(side)>() &= ~flips;
+
+    hash ^= ZOBRIST_DISC[side][moveId];
+    for (uint64_t b = flips; b; b &= b - 1)
+        hash ^= ZOBRIST_FLIP[firstSquare(b)];
+}
+
+/*
+ * Writes all the legal moves of the side into a fixed array. The moves keep
+ * the historical x-major scan order, which callers rely on for tie-breaking,
+ * so the mask is transposed (x <-> y) before its bits are walked.
+ */
+template <Side side>
+inline int Board::getLegalMoves(MoveList &list) const {
+    uint64_t t = flipDiagonal(getLegalMoveMask<side>());
+
+    list.size = 0;
+    while (t)
+    {
+        int j = firstSquare(t);
+        t &= t - 1;
+        list.moves[list.size++] = j / 8 + 8 * (j % 8);  // trace the moveId for a legal move
+    }
+    return list.size;
+}
+
+/*
+ * Returns true if a move is legal for the side; passing is only legal
+ * without a move.
+ */
+template <Side side>
+inline bool Board::checkMove(PackedMove m) const {
+    if (m.isPass()) return getLegalMoveMask<side>() == 0;
+    if (!m.onBoard()) return false;
+
+    return (getLegalMoveMask<side>() >> m.id) & 1;
+}
+
+/*
+ * Modifies the board to reflect the move; a pass, or a move that is not
+ * legal, changes nothing.
+ */
+template <Side side>
+inline void Board::doMove(PackedMove m) {
+    if (!m.onBoard() || (((black | white) >> m.id) & 1)) return;
+
+    uint64_t flips = getFlips(getMask<side>(), getMask<opponentOf(side)>(), m.id);
+    if (flips == 0) return;
+
+    placeDisc<side>(m.id, flips);
+}
+
+/*
+ * Plays moveId (or PASS) for the side in place and pushes what changed onto
+ * the undo stack. Unlike doMove() the move is not validated: it must come
+ * from getLegalMoves(). Returns the flipped discs.
+ */
+template <Side side>
+inline uint64_t Board::makeMove(int moveId) {
+    UndoRecord &record = undoStack[undoTop++];
+    record.moveId = moveId;
+    record.side = side;
+    record.flips = 0;
+    record.hash = hash;
+    if (moveId == PASS) return 0;
+
+    uint64_t flips = getFlips(getMask<side>(), getMask<opponentOf(side)>(), moveId);
+    record.flips = flips;
+    placeDisc<side>(moveId, flips);
+    return flips;
+}
+
+template <Side side>
+inline void Board::undoMove() {
+    const UndoRecord &record = undoStack[--undoTop];
+    if (record.moveId == PASS) return;
+
+    discs<side>() &= ~(record.flips | (1ULL << record.moveId));
+    discs<opponentOf(side)>() |= record.flips;
+    hash = record.hash;
+}
+
 #endif
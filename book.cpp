@@ -0,0 +1,199 @@
+#include "book.hpp"
+#include "zobrist.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+ * File header, followed by count BookEntry records sorted by key.
+ */
+struct BookHeader {
+    char magic[8];
+    uint64_t count;
+};
+
+static const char BOOK_MAGIC[8] = { 'O', 'T', 'H', 'B', 'O', 'O', 'K', '1' };
+
+static bool keyLess(const BookEntry &a, const BookEntry &b) {
+    return a.key < b.key;
+}
+
+/*
+ * Applies a symmetry to a mask, in the same way symmetricSquare() moves a
+ * square: bit 4 transposes, then bit 1 mirrors x and bit 2 mirrors y.
+ */
+static uint64_t transformMask(uint64_t b, int symmetry) {
+    if (symmetry & 4)
+        b = flipDiagonal(b);
+    if (symmetry & 1)
+        b = mirrorHorizontal(b);
+    if (symmetry & 2)
+        b = flipVertical(b);
+    return b;
+}
+
+/*
+ * Zobrist key of a position given as masks.
+ */
+static uint64_t hashMasks(uint64_t black, uint64_t white, Side side) {
+    uint64_t key = (side == BLACK) ? 0 : ZOBRIST_SIDE;
+    for (uint64_t b = black; b; b &= b - 1)
+        key ^= ZOBRIST_DISC[BLACK][firstSquare(b)];
+    for (uint64_t b = white; b; b &= b - 1)
+        key ^= ZOBRIST_DISC[WHITE][firstSquare(b)];
+    return key;
+}
+
+/*
+ * Make an empty (closed) book.
+ */
+OpeningBook::OpeningBook() {
+    entries = nullptr;
+    count = 0;
+    mapping = nullptr;
+    mappingSize = 0;
+}
+
+/*
+ * Destructor for the book.
+ */
+OpeningBook::~OpeningBook() {
+    close();
+}
+
+/*
+ * Maps the book file at path. Returns false (leaving the book closed) if the
+ * file is missing or not a valid book.
+ */
+bool OpeningBook::open(const char *path) {
+    close();
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t) info.st_size < sizeof(BookHeader)) {
+        ::close(fd);
+        return false;
+    }
+
+    size_t size = info.st_size;
+    void *memory = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (memory == MAP_FAILED)
+        return false;
+
+    const BookHeader *header = static_cast<const BookHeader *>(memory);
+    if (memcmp(header->magic, BOOK_MAGIC, sizeof(BOOK_MAGIC)) != 0
+            || size != sizeof(BookHeader) + header->count * sizeof(BookEntry)) {
+        munmap(memory, size);
+        return false;
+    }
+
+    mapping = memory;
+    mappingSize = size;
+    count = header->count;
+    entries = reinterpret_cast<const BookEntry *>(static_cast<const char *>(memory) + sizeof(BookHeader));
+    return true;
+}
+
+/*
+ * Unmaps the book, if one is open.
+ */
+void OpeningBook::close() {
+    if (mapping != nullptr)
+        munmap(mapping, mappingSize);
+    entries = nullptr;
+    count = 0;
+    mapping = nullptr;
+    mappingSize = 0;
+}
+
+int OpeningBook::transformSquare(int sq, int symmetry) {
+    return symmetricSquare(sq, symmetry);
+}
+
+/*
+ * The smallest Zobrist key over the 8 symmetric images of the position;
+ * symmetry is set to the symmetry producing that image.
+ */
+uint64_t OpeningBook::canonicalKey(Board &board, Side side, int &symmetry) {
+    uint64_t best = 0;
+    symmetry = 0;
+    for (int s = 0; s < 8; s++) {
+        uint64_t key = hashMasks(transformMask(board.getMask(BLACK), s),
+                                 transformMask(board.getMask(WHITE), s), side);
+        if (s == 0 || key < best) {
+            best = key;
+            symmetry = s;
+        }
+    }
+    return best;
+}
+
+/*
+ * Binary search for the position. On a hit the stored move is mapped back to
+ * this position's orientation and checked for legality.
+ */
+bool OpeningBook::probe(Board &board, Side side, int &moveId, int &score) {
+    if (count == 0)
+        return false;
+
+    int symmetry;
+    BookEntry wanted;
+    wanted.key = canonicalKey(board, side, symmetry);
+    const BookEntry *found = std::lower_bound(entries, entries + count, wanted, keyLess);
+    if (found == entries + count || found->key != wanted.key)
+        return false;
+
+    for (int sq = 0; sq < 64; sq++) {
+        if (transformSquare(sq, symmetry) == found->move) {
+            if (!board.checkMove(PackedMove(sq), side))
+                return false;
+            moveId = sq;
+            score = found->score;
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * Reads every entry of a book file into out (for extending a book).
+ */
+bool OpeningBook::load(const char *path, vector<BookEntry> &out) {
+    OpeningBook book;
+    if (!book.open(path))
+        return false;
+    out.assign(book.entries, book.entries + book.count);
+    return true;
+}
+
+/*
+ * Sorts the entries, keeps the last one given for each key, and writes the
+ * book file.
+ */
+bool OpeningBook::save(const char *path, vector<BookEntry> &in) {
+    std::stable_sort(in.begin(), in.end(), keyLess);
+    vector<BookEntry> unique;
+    for (size_t i = 0; i < in.size(); i++) {
+        if (!unique.empty() && unique.back().key == in[i].key)
+            unique.back() = in[i];
+        else
+            unique.push_back(in[i]);
+    }
+
+    FILE *file = fopen(path, "wb");
+    if (file == nullptr)
+        return false;
+    BookHeader header;
+    memcpy(header.magic, BOOK_MAGIC, sizeof(BOOK_MAGIC));
+    header.count = unique.size();
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1
+        && fwrite(unique.data(), sizeof(BookEntry), unique.size(), file) == unique.size();
+    return fclose(file) == 0 && ok;
+}
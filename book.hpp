@@ -0,0 +1,68 @@
+#ifndef __BOOK_H__
+#define __BOOK_H__
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include "common.hpp"
+#include "board.hpp"
+
+using namespace std;
+
+/*
+ * One book position: the canonical key of the position (see
+ * OpeningBook::canonicalKey), the best move in the canonical orientation and
+ * its search score for the side to move.
+ */
+struct BookEntry {
+    uint64_t key;
+    int16_t score;
+    uint8_t move;
+    uint8_t depth;      // depth of the search that produced the entry
+    uint8_t reserved[4];
+};
+
+/*
+ * Read-only opening book. The file is a small header followed by BookEntry
+ * records sorted by key; it is mapped into memory with mmap and searched in
+ * place with a binary search, so opening it costs nothing and it is never
+ * copied onto the heap.
+ *
+ * Positions are stored once for all 8 board symmetries: the key is the
+ * smallest Zobrist key over the symmetric images of the position, and the
+ * move is stored for that image. Keys depend on the fixed Zobrist seed, so a
+ * book must be rebuilt if the keys ever change.
+ */
+class OpeningBook {
+
+private:
+    const BookEntry *entries;
+    size_t count;
+    void *mapping;
+    size_t mappingSize;
+
+public:
+    OpeningBook();
+    ~OpeningBook();
+    OpeningBook(const OpeningBook &) = delete;
+    OpeningBook &operator=(const OpeningBook &) = delete;
+
+    bool open(const char *path);
+    void close();
+    bool isOpen() { return mapping != nullptr; }
+    size_t size() { return count; }
+
+    // looks the position up; on a hit sets moveId (a legal move) and score
+    bool probe(Board &board, Side side, int &moveId, int &score);
+
+    // the position's key, and which symmetry maps it to the stored image
+    static uint64_t canonicalKey(Board &board, Side side, int &symmetry);
+    // where square sq ends up under the given symmetry (0 = identity)
+    static int transformSquare(int sq, int symmetry);
+
+    // for the builder: read a whole book file, and write one (sorted, last entry per key wins)
+    static bool load(const char *path, vector<BookEntry> &out);
+    static bool save(const char *path, vector<BookEntry> &in);
+};
+
+#endif
@@ -0,0 +1,175 @@
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <set>
+#include "book.hpp"
+#include "search.hpp"
+using namespace std;
+
+/*
+ * Offline opening-book builder.
+ *
+ * Starting from the standard position, every position up to a given number
+ * of plies is searched to a fixed depth, and the best move and score are
+ * recorded. Only moves scoring within a window of the best are followed, so
+ * the book covers the lines worth playing rather than the whole tree. With
+ * -x the existing book is loaded first: its entries that are already deep
+ * enough are reused rather than searched again, and new ones are added.
+ */
+
+struct BuildOptions {
+    const char *path;
+    int plies;
+    int depth;
+    int window;
+    int threads;
+    bool extend;
+};
+
+static TranspositionTable *table;
+static SearchPool *pool;
+static map<uint64_t, BookEntry> book;
+static set<uint64_t> visited;
+static long long searched;
+
+/*
+ * Score of the position for the side to move, from the book if it is known
+ * deeply enough, otherwise from a fixed-depth search.
+ */
+static int scorePosition(Board &board, Side side, int depth) {
+    int symmetry;
+    map<uint64_t, BookEntry>::iterator known = book.find(OpeningBook::canonicalKey(board, side, symmetry));
+    if (known != book.end() && known->second.depth >= depth)
+        return known->second.score;
+
+    SearchLimits limits;
+    limits.maxDepth = depth;
+    int moveId;
+    ++searched;
+    return pool->search(board, side, limits, moveId);
+}
+
+/*
+ * Adds the position and the lines worth playing from it to the book.
+ */
+static void expand(Board &board, Side side, int ply, const BuildOptions &options) {
+    if (ply >= options.plies || board.isDone())
+        return;
+
+    Side other = (side == BLACK) ? WHITE : BLACK;
+    MoveList legalMoves;
+    if (board.getLegalMoves(side, legalMoves) < 1) {
+        board.makeMove(PASS, side);
+        expand(board, other, ply, options);
+        board.undoMove();
+        return;
+    }
+
+    int symmetry;
+    uint64_t key = OpeningBook::canonicalKey(board, side, symmetry);
+    if (!visited.insert(key).second)
+        return;
+
+    int scores[MAX_MOVES];
+    int best = 0;
+    for (int i = 0; i < legalMoves.size; i++) {
+        board.makeMove(legalMoves.moves[i], side);
+        scores[i] = -scorePosition(board, other, options.depth - 1);
+        board.undoMove();
+        if (scores[i] > scores[best])
+            best = i;
+    }
+
+    map<uint64_t, BookEntry>::iterator known = book.find(key);
+    if (known == book.end() || known->second.depth < options.depth) {
+        BookEntry entry;
+        memset(&entry, 0, sizeof(entry));
+        entry.key = key;
+        entry.score = scores[best];
+        entry.move = OpeningBook::transformSquare(legalMoves.moves[best], symmetry);
+        entry.depth = options.depth;
+        book[key] = entry;
+    }
+
+    if (visited.size() % 100 == 0)
+        cerr << "book: " << book.size() << " positions, " << searched << " searches" << endl;
+
+    for (int i = 0; i < legalMoves.size; i++) {
+        if (scores[i] < scores[best] - options.window)
+            continue;
+        board.makeMove(legalMoves.moves[i], side);
+        expand(board, other, ply + 1, options);
+        board.undoMove();
+    }
+}
+
+static void usage(const char *name) {
+    cerr << "usage: " << name << " [-o book] [-p plies] [-d depth] [-w window] [-t threads] [-x]" << endl
+         << "  -o  book file to write (default othello.book)" << endl
+         << "  -p  follow lines up to this many plies from the start (default 6)" << endl
+         << "  -d  search depth per position (default 10)" << endl
+         << "  -w  follow moves scoring within this much of the best (default 10)" << endl
+         << "  -t  search threads (default 1)" << endl
+         << "  -x  extend the existing book instead of starting afresh" << endl;
+    exit(-1);
+}
+
+int main(int argc, char *argv[]) {
+    BuildOptions options;
+    options.path = "othello.book";
+    options.plies = 6;
+    options.depth = 10;
+    options.window = 10;
+    options.threads = 1;
+    options.extend = false;
+
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (!strcmp(argv[i], "-o") && hasValue)
+            options.path = argv[++i];
+        else if (!strcmp(argv[i], "-p") && hasValue)
+            options.plies = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-d") && hasValue)
+            options.depth = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-w") && hasValue)
+            options.window = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-t") && hasValue)
+            options.threads = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-x"))
+            options.extend = true;
+        else
+            usage(argv[0]);
+    }
+    if (options.depth < 2 || options.depth > MAX_SEARCH_DEPTH)
+        usage(argv[0]);
+
+    if (options.extend) {
+        vector<BookEntry> existing;
+        if (!OpeningBook::load(options.path, existing)) {
+            cerr << "cannot read book " << options.path << endl;
+            return 1;
+        }
+        for (size_t i = 0; i < existing.size(); i++)
+            book[existing[i].key] = existing[i];
+        cerr << "book: extending " << book.size() << " positions" << endl;
+    }
+
+    table = new TranspositionTable(256);
+    pool = new SearchPool(options.threads, table);
+    Board start;
+    expand(start, BLACK, 0, options);
+
+    vector<BookEntry> entries;
+    for (map<uint64_t, BookEntry>::iterator it = book.begin(); it != book.end(); ++it)
+        entries.push_back(it->second);
+    if (!OpeningBook::save(options.path, entries)) {
+        cerr << "cannot write book " << options.path << endl;
+        return 1;
+    }
+    cerr << "book: wrote " << entries.size() << " positions to " << options.path << endl;
+
+    delete pool;
+    delete table;
+    return 0;
+}
@@ -0,0 +1,290 @@
+#include <iostream>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+#include "eval.hpp"
+#include "probcut.hpp"
+#include "search.hpp"
+using namespace std;
+
+/*
+ * Offline calibration of the Multi-ProbCut parameters.
+ *
+ * Self-play games (a few random plies, then shallow searches with an
+ * occasional random move) supply the positions. Every position with more
+ * than -e empties is searched to each depth from 1 to -d with a full
+ * window; each depth from PROBCUT_MIN_DEPTH on is paired with its shallow
+ * depth (ProbCut::shallowDepth), and a least-squares line through the pairs
+ * of each stage and depth gives the slope, intercept and error sigma the
+ * search cuts with. Depths past -d reuse the fit of -d.
+ *
+ * The searches use the evaluation the engine will use (-i), since the
+ * parameters are in its units, and a table cleared for every position, so
+ * that no shallow result is taken from a deeper search.
+ */
+
+// Pairs a stage and depth needs for its fit to be trusted.
+static const int MIN_PAIRS = 50;
+// Transposition table of each worker, in MB.
+static const int WORKER_TT_MB = 4;
+
+struct CalibrateOptions {
+    int games;
+    int openingPlies;
+    int playDepth;
+    double randomRate;      // share of self-play moves picked at random
+    int maxDepth;
+    int minEmpties;
+    int threads;
+    unsigned seed;
+    const char *input;      // pattern weights, or nullptr for the square weights
+    const char *output;
+};
+
+/*
+ * Running sums of the (shallow, deep) pairs of one stage and depth.
+ */
+struct PairSums {
+    double n, x, y, xx, xy, yy;
+
+    void add(double shallow, double deep) {
+        n += 1;
+        x += shallow;
+        y += deep;
+        xx += shallow * shallow;
+        xy += shallow * deep;
+        yy += deep * deep;
+    }
+};
+
+/*
+ * The sums of every stage and depth.
+ */
+struct Calibration {
+    PairSums pairs[NUM_STAGES][PROBCUT_MAX_DEPTH + 1];
+};
+
+static PatternEval eval;
+static bool patternEval;
+static atomic<int> nextGame;
+static mutex sumsLock;
+static Calibration total;
+
+/*
+ * Searches the position to every depth up to maxDepth and adds its pairs to
+ * out. Positions where a search reaches the end of the game are left out:
+ * their scores are exact, not estimates.
+ */
+static void calibratePosition(const CalibrateOptions &options, Search &search, TranspositionTable &tt,
+                              Board &board, Side side, Calibration &out) {
+    int scores[PROBCUT_MAX_DEPTH + 1];
+    tt.clear();
+    search.setPosition(board);
+    for (int depth = 1; depth <= options.maxDepth; depth++) {
+        int moveId;
+        scores[depth] = search.searchRoot(side, depth, moveId);
+        if (scores[depth] >= SCORE_WIN / 2 || scores[depth] <= -SCORE_WIN / 2)
+            return;
+    }
+
+    int stage = PatternEval::stageOf(board.countBlack() + board.countWhite());
+    for (int depth = PROBCUT_MIN_DEPTH; depth <= options.maxDepth; depth++)
+        out.pairs[stage][depth].add(scores[ProbCut::shallowDepth(depth)], scores[depth]);
+}
+
+/*
+ * Plays one self-play game and calibrates on its positions.
+ */
+static void playGame(const CalibrateOptions &options, int game, TranspositionTable &tt, Calibration &out) {
+    mt19937 random(options.seed + 7919u * game);
+    uniform_real_distribution<double> chance(0.0, 1.0);
+    Board board;
+    Search search(board, &tt);
+    if (patternEval)
+        search.setEvaluation(&eval);
+
+    Side side = BLACK;
+    for (int ply = 0; !board.isDone(); ply++) {
+        Side other = (side == BLACK) ? WHITE : BLACK;
+        MoveList legalMoves;
+        if (board.getLegalMoves(side, legalMoves) == 0) {
+            board.makeMove(PASS, side);
+            side = other;
+            continue;
+        }
+
+        int empties = 64 - board.countBlack() - board.countWhite();
+        if (empties > options.minEmpties && empties > options.maxDepth)
+            calibratePosition(options, search, tt, board, side, out);
+
+        int moveId;
+        if (ply < options.openingPlies || chance(random) < options.randomRate)
+            moveId = legalMoves.moves[random() % legalMoves.size];
+        else {
+            SearchLimits limits;
+            limits.maxDepth = options.playDepth;
+            tt.newSearch();
+            search.setPosition(board);
+            search.iterativeDeepening(side, limits, moveId);
+        }
+        board.makeMove(moveId, side);
+        side = other;
+    }
+}
+
+/*
+ * Worker thread: plays games until none are left, then adds its sums to
+ * the shared ones.
+ */
+static void worker(const CalibrateOptions &options) {
+    TranspositionTable tt(WORKER_TT_MB);
+    Calibration mine = Calibration();
+    for (int game = nextGame++; game < options.games; game = nextGame++) {
+        playGame(options, game, tt, mine);
+        if ((game + 1) % 20 == 0) {
+            lock_guard<mutex> lock(sumsLock);
+            cerr << "calibrator: " << game + 1 << "/" << options.games << " games" << endl;
+        }
+    }
+
+    lock_guard<mutex> lock(sumsLock);
+    for (int stage = 0; stage < NUM_STAGES; stage++)
+        for (int depth = 0; depth <= PROBCUT_MAX_DEPTH; depth++) {
+            PairSums &to = total.pairs[stage][depth];
+            const PairSums &from = mine.pairs[stage][depth];
+            to.n += from.n;
+            to.x += from.x;
+            to.y += from.y;
+            to.xx += from.xx;
+            to.xy += from.xy;
+            to.yy += from.yy;
+        }
+}
+
+/*
+ * Least-squares line deep = slope * shallow + intercept through the pairs,
+ * with the standard deviation of what it leaves unexplained. False if there
+ * are too few pairs, or they do not determine the line.
+ */
+static bool fitLine(const PairSums &s, ProbCutFit &fit) {
+    if (s.n < MIN_PAIRS)
+        return false;
+    double varX = s.xx / s.n - (s.x / s.n) * (s.x / s.n);
+    double covXY = s.xy / s.n - (s.x / s.n) * (s.y / s.n);
+    double varY = s.yy / s.n - (s.y / s.n) * (s.y / s.n);
+    if (varX <= 0)
+        return false;
+    double slope = covXY / varX;
+    double residual = varY - slope * covXY;
+    fit.slope = (float) slope;
+    fit.intercept = (float) (s.y / s.n - slope * s.x / s.n);
+    fit.sigma = (float) sqrt(residual > 1 ? residual : 1);
+    return slope > 0.1;
+}
+
+static void usage(const char *name) {
+    cerr << "usage: " << name << " [options]" << endl
+         << "  -g  self-play games (default 200)" << endl
+         << "  -o  random plies at the start of each game (default 8)" << endl
+         << "  -p  search depth of the self-play moves (default 4)" << endl
+         << "  -r  share of self-play moves played at random (default 0.1)" << endl
+         << "  -d  deepest search to calibrate (default 10)" << endl
+         << "  -e  leave out positions with this many empties or fewer (default 12)" << endl
+         << "  -i  pattern weights the engine uses, or square (default othello.weights)" << endl
+         << "  -j  threads (default: one per core)" << endl
+         << "  -x  seed (default 1)" << endl
+         << "  -w  parameters file to write (default othello.probcut)" << endl;
+    exit(-1);
+}
+
+int main(int argc, char *argv[]) {
+    CalibrateOptions options;
+    options.games = 200;
+    options.openingPlies = 8;
+    options.playDepth = 4;
+    options.randomRate = 0.1;
+    options.maxDepth = 10;
+    options.minEmpties = 12;
+    options.threads = (int) thread::hardware_concurrency();
+    options.seed = 1;
+    options.input = "othello.weights";
+    options.output = "othello.probcut";
+
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (!strcmp(argv[i], "-g") && hasValue)
+            options.games = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-o") && hasValue)
+            options.openingPlies = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-p") && hasValue)
+            options.playDepth = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-r") && hasValue)
+            options.randomRate = atof(argv[++i]);
+        else if (!strcmp(argv[i], "-d") && hasValue)
+            options.maxDepth = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-e") && hasValue)
+            options.minEmpties = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-i") && hasValue) {
+            ++i;
+            options.input = strcmp(argv[i], "square") ? argv[i] : nullptr;
+        }
+        else if (!strcmp(argv[i], "-j") && hasValue)
+            options.threads = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-x") && hasValue)
+            options.seed = (unsigned) atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-w") && hasValue)
+            options.output = argv[++i];
+        else
+            usage(argv[0]);
+    }
+    if (options.playDepth < 1 || options.maxDepth < PROBCUT_MIN_DEPTH || options.maxDepth > PROBCUT_MAX_DEPTH)
+        usage(argv[0]);
+    if (options.threads < 1)
+        options.threads = 1;
+
+    // as the player does: the default pattern weights if the file is missing
+    patternEval = options.input != nullptr;
+    if (patternEval && !eval.load(options.input))
+        cerr << "calibrator: cannot read weights " << options.input << ", using the default pattern weights" << endl;
+
+    vector<thread> workers;
+    for (int i = 0; i < options.threads; i++)
+        workers.push_back(thread(worker, cref(options)));
+    for (thread &t : workers)
+        t.join();
+
+    ProbCut cuts;
+    for (int stage = 0; stage < NUM_STAGES; stage++) {
+        ProbCutFit last = { 1.0f, 0.0f, 0.0f };
+        for (int depth = PROBCUT_MIN_DEPTH; depth <= PROBCUT_MAX_DEPTH; depth++) {
+            ProbCutFit fit;
+            if (depth <= options.maxDepth) {
+                const PairSums &sums = total.pairs[stage][depth];
+                if (fitLine(sums, fit)) {
+                    fprintf(stderr, "stage %2d depth %2d/%d: %6.0f pairs, deep = %.3f * shallow %+.1f, sigma %.1f\n",
+                            stage, depth, ProbCut::shallowDepth(depth), sums.n,
+                            fit.slope, fit.intercept, fit.sigma);
+                    last = fit;
+                }
+                else
+                    fit = { 1.0f, 0.0f, 0.0f };
+            }
+            else
+                fit = last;
+            cuts.at(stage, depth) = fit;
+        }
+    }
+
+    if (!cuts.save(options.output)) {
+        cerr << "cannot write parameters " << options.output << endl;
+        return 1;
+    }
+    cerr << "calibrator: parameters written to " << options.output << endl;
+    return 0;
+}
@@ -1,10 +1,16 @@
 #ifndef __COMMON_H__
 #define __COMMON_H__
 
+#include <cstdint>
+#include <string>
+
 enum Side { 
     WHITE, BLACK
 };
 
+// The other side; usable as a template argument.
+constexpr Side opponentOf(Side side) { return side == BLACK ? WHITE : BLACK; }
+
 class Move {
    
 public:
@@ -22,4 +28,47 @@ public:
     void setY(int y) { this->y = y; }
 };
 
+// Move id used for a pass in makeMove()/MoveList and by PackedMove.
+const int PASS = -1;
+
+/*
+ * A move as a plain value: the square index x + 8*y in one byte, or PASS.
+ * Board and Player hand these around by value; Move * is kept for the
+ * framework's interface. Coordinates off the board pack to OFF_BOARD, which
+ * no legality check accepts.
+ */
+class PackedMove {
+
+public:
+    static const int OFF_BOARD = 64;
+    int8_t id;
+
+    PackedMove() : id(PASS) {}
+    explicit PackedMove(int id) : id((int8_t) id) {}
+    PackedMove(int x, int y) : id((int8_t) ((x >= 0 && x < 8 && y >= 0 && y < 8) ? x + 8*y : OFF_BOARD)) {}
+
+    static PackedMove pass() { return PackedMove(); }
+    // nullptr is a pass
+    static PackedMove of(const Move *m) { return m == nullptr ? PackedMove() : PackedMove(m->x, m->y); }
+
+    bool isPass() const { return id == PASS; }
+    bool onBoard() const { return id >= 0 && id < OFF_BOARD; }
+    int getX() const { return id % 8; }
+    int getY() const { return id / 8; }
+    // a heap copy for the Move * interface, or nullptr for a pass
+    Move *toMove() const { return isPass() ? nullptr : new Move(getX(), getY()); }
+
+    bool operator==(PackedMove other) const { return id == other.id; }
+    bool operator!=(PackedMove other) const { return id != other.id; }
+};
+
+/*
+ * Name of a move id in the usual notation (a1 .. h8), or "pass".
+ */
+inline std::string squareName(int moveId) {
+    if (moveId == PASS)
+        return "pass";
+    return std::string(1, (char) ('a' + moveId % 8)) + (char) ('1' + moveId / 8);
+}
+
 #endif
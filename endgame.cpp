@@ -0,0 +1,503 @@
+#include "endgame.hpp"
+
+// Empties from which moves are generated and sorted fastest-first.
+static const int FASTEST_FIRST_EMPTIES = 7;
+// Empties from which positions go through the transposition table.
+static const int TT_MIN_EMPTIES = 9;
+// Nodes between two looks at the clock.
+static const int TIME_CHECK_INTERVAL = 4096;
+// Scores are disc differentials, so this bound is never reached.
+static const int SOLVE_INF = 65;
+
+/*
+ * Order in which the empty-square list is built: corners, then the other
+ * edge and inner squares, the X- and C-squares last.
+ */
+static const int SQUARE_ORDER[64] = {
+     0,  7, 56, 63,                     // corners
+     2,  5, 16, 23, 40, 47, 58, 61,     // A-squares
+     3,  4, 24, 31, 32, 39, 59, 60,     // B-squares
+    18, 21, 42, 45,                     // inner corners
+    19, 20, 26, 29, 34, 37, 43, 44,
+    11, 12, 25, 30, 33, 38, 51, 52,
+    10, 13, 17, 22, 41, 46, 50, 53,
+    27, 28, 35, 36,                     // centre
+     1,  6,  8, 15, 48, 55, 57, 62,     // C-squares
+     9, 14, 49, 54                      // X-squares
+};
+
+/*
+ * Transposition-table key of a P/O position. A multiplicative mix of the
+ * masks is much cheaper than rebuilding the Zobrist key at every node, and
+ * it keeps endgame entries apart from the midgame search's entries (whose
+ * scores are on a different scale).
+ */
+static uint64_t hashMasks(uint64_t P, uint64_t O) {
+    uint64_t h = P * 0x9E3779B97F4A7C15ULL;
+    h ^= (O * 0xC2B2AE3D27D4EB4FULL) >> 7 | (O * 0xC2B2AE3D27D4EB4FULL) << 57;
+    h ^= h >> 31;
+    h *= 0xBF58476D1CE4E5B9ULL;
+    return h ^ (h >> 29);
+}
+
+/*
+ * Score of a position where neither side can move.
+ */
+static int scoreFinal(uint64_t P, uint64_t O) {
+    int mine = popCount(P);
+    int theirs = popCount(O);
+    int empties = 64 - mine - theirs;
+    if (mine > theirs)
+        return mine - theirs + empties;
+    if (mine < theirs)
+        return mine - theirs - empties;
+    return 0;
+}
+
+/*
+ * Make a solver; the table, if given, is shared with the midgame search.
+ */
+EndgameSolver::EndgameSolver(TranspositionTable *table) {
+    tt = table;
+    nodes = 0;
+    timed = false;
+    stopped = false;
+    checkCountdown = TIME_CHECK_INTERVAL;
+    parity = 0;
+    head.sq = -1;
+    head.prev = head.next = &head;
+}
+
+/*
+ * Destructor for the solver.
+ */
+EndgameSolver::~EndgameSolver() {
+}
+
+void EndgameSolver::setDeadline(SearchClock::time_point deadline) {
+    timed = true;
+    hardStop = deadline;
+}
+
+/*
+ * Returns true once the deadline has passed; the clock is only read every
+ * TIME_CHECK_INTERVAL calls.
+ */
+bool EndgameSolver::timeUp() {
+    if (!stopped && timed && --checkCountdown <= 0)
+    {
+        checkCountdown = TIME_CHECK_INTERVAL;
+        stopped = SearchClock::now() >= hardStop;
+    }
+    return stopped;
+}
+
+/*
+ * Builds the empty-square list and quadrant parity for a position.
+ */
+void EndgameSolver::setup(uint64_t P, uint64_t O) {
+    uint64_t empty = ~(P | O);
+    head.prev = head.next = &head;
+    parity = 0;
+    for (int i = 0; i < 64; ++i)
+    {
+        int sq = SQUARE_ORDER[i];
+        if (!((empty >> sq) & 1))
+            continue;
+        Empty &node = squares[sq];
+        node.sq = sq;
+        node.quadrant = 1u << ((sq % 8 >= 4) + 2 * (sq / 8 >= 4));
+        node.prev = head.prev;
+        node.next = &head;
+        head.prev->next = &node;
+        head.prev = &node;
+        parity ^= node.quadrant;
+    }
+}
+
+void EndgameSolver::removeEmpty(Empty *empty) {
+    empty->prev->next = empty->next;
+    empty->next->prev = empty->prev;
+    parity ^= empty->quadrant;
+}
+
+void EndgameSolver::restoreEmpty(Empty *empty) {
+    empty->prev->next = empty;
+    empty->next->prev = empty;
+    parity ^= empty->quadrant;
+}
+
+/*
+ * One empty square left: O must be every other square. Whoever can play
+ * there does; otherwise the game ends with the square going to the winner.
+ */
+int EndgameSolver::solve1(uint64_t P, uint64_t O, int sq)
+{
+    ++nodes;
+    int mine = popCount(P);
+    uint64_t flips = getFlips(P, O, sq);
+    if (flips)
+        return 2 * (mine + popCount(flips) + 1) - 64;
+
+    flips = getFlips(O, P, sq);
+    if (flips)
+        return 2 * (mine - popCount(flips)) - 64;
+
+    int diff = 2 * mine - 63;
+    return diff > 0 ? diff + 1 : diff - 1;
+}
+
+/*
+ * Two empty squares left.
+ */
+int EndgameSolver::solve2(uint64_t P, uint64_t O, int alpha, int beta, int sq1, int sq2, bool passed)
+{
+    ++nodes;
+    int bestScore = -SOLVE_INF;
+    uint64_t flips = getFlips(P, O, sq1);
+    if (flips)
+    {
+        bestScore = -solve1(O & ~flips, P | flips | (1ULL << sq1), sq2);
+        if (bestScore >= beta)
+            return bestScore;
+    }
+    flips = getFlips(P, O, sq2);
+    if (flips)
+    {
+        int score = -solve1(O & ~flips, P | flips | (1ULL << sq2), sq1);
+        if (score > bestScore)
+            bestScore = score;
+    }
+
+    if (bestScore == -SOLVE_INF)
+    {
+        if (passed)
+            return scoreFinal(P, O);
+        return -solve2(O, P, -beta, -alpha, sq1, sq2, true);
+    }
+    return bestScore;
+}
+
+/*
+ * Three empty squares left. A square alone in its quadrant is tried first.
+ */
+int EndgameSolver::solve3(uint64_t P, uint64_t O, int alpha, int beta, int sq1, int sq2, int sq3, bool passed)
+{
+    ++nodes;
+    unsigned q1 = squares[sq1].quadrant;
+    unsigned q2 = squares[sq2].quadrant;
+    unsigned q3 = squares[sq3].quadrant;
+    if (q1 == q2 && q1 != q3)
+    {
+        int t = sq1; sq1 = sq3; sq3 = t;
+    }
+    else if (q1 == q3 && q1 != q2)
+    {
+        int t = sq1; sq1 = sq2; sq2 = t;
+    }
+
+    int bestScore = -SOLVE_INF;
+    uint64_t flips = getFlips(P, O, sq1);
+    if (flips)
+    {
+        bestScore = -solve2(O & ~flips, P | flips | (1ULL << sq1), -beta, -alpha, sq2, sq3, false);
+        if (bestScore >= beta)
+            return bestScore;
+        if (bestScore > alpha)
+            alpha = bestScore;
+    }
+    flips = getFlips(P, O, sq2);
+    if (flips)
+    {
+        int score = -solve2(O & ~flips, P | flips | (1ULL << sq2), -beta, -alpha, sq1, sq3, false);
+        if (score >= beta)
+            return score;
+        if (score > bestScore)
+        {
+            bestScore = score;
+            if (score > alpha)
+                alpha = score;
+        }
+    }
+    flips = getFlips(P, O, sq3);
+    if (flips)
+    {
+        int score = -solve2(O & ~flips, P | flips | (1ULL << sq3), -beta, -alpha, sq1, sq2, false);
+        if (score > bestScore)
+            bestScore = score;
+    }
+
+    if (bestScore == -SOLVE_INF)
+    {
+        if (passed)
+            return scoreFinal(P, O);
+        return -solve3(O, P, -beta, -alpha, sq1, sq2, sq3, true);
+    }
+    return bestScore;
+}
+
+/*
+ * Shallow endgame (4 to FASTEST_FIRST_EMPTIES - 1 empties): no move
+ * generation, the empty list is walked for odd-parity quadrants first.
+ */
+int EndgameSolver::solveParity(uint64_t P, uint64_t O, int alpha, int beta, int empties, bool passed)
+{
+    ++nodes;
+    if (timeUp())
+        return 0;
+
+    int bestScore = -SOLVE_INF;
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        // pass 0: quadrants with an odd number of empties; pass 1: the others
+        unsigned wanted = pass == 0 ? parity : ~parity;
+        for (Empty *empty = head.next; empty != &head; empty = empty->next)
+        {
+            if (!(empty->quadrant & wanted))
+                continue;
+            int sq = empty->sq;
+            uint64_t flips = getFlips(P, O, sq);
+            if (!flips)
+                continue;
+
+            uint64_t nextP = O & ~flips;
+            uint64_t nextO = P | flips | (1ULL << sq);
+            removeEmpty(empty);
+            int score;
+            if (empties == 4)
+            {
+                Empty *e = head.next;
+                score = -solve3(nextP, nextO, -beta, -alpha, e->sq, e->next->sq, e->next->next->sq, false);
+            }
+            else
+            {
+                score = -solveParity(nextP, nextO, -beta, -alpha, empties - 1, false);
+            }
+            restoreEmpty(empty);
+            if (stopped)
+                return 0;
+
+            if (score > bestScore)
+            {
+                bestScore = score;
+                if (score > alpha)
+                {
+                    alpha = score;
+                    if (alpha >= beta)
+                        return bestScore;
+                }
+            }
+        }
+    }
+
+    if (bestScore == -SOLVE_INF)
+    {
+        if (passed)
+            return scoreFinal(P, O);
+        return -solveParity(O, P, -beta, -alpha, empties, true);
+    }
+    return bestScore;
+}
+
+/*
+ * Deep endgame: moves are generated and tried fastest-first (fewest
+ * opponent replies, corners as a tie-break), with the hash move in front,
+ * using a principal-variation search over the transposition table.
+ */
+int EndgameSolver::solveDeep(uint64_t P, uint64_t O, int alpha, int beta, int empties, bool passed)
+{
+    if (empties < FASTEST_FIRST_EMPTIES)
+    {
+        if (empties == 3)
+        {
+            Empty *e = head.next;
+            return solve3(P, O, alpha, beta, e->sq, e->next->sq, e->next->next->sq, passed);
+        }
+        if (empties == 2)
+            return solve2(P, O, alpha, beta, head.next->sq, head.next->next->sq, passed);
+        if (empties == 1)
+        {
+            // solve1() assumes the side to move can play or the game ends there
+            return solve1(P, O, head.next->sq);
+        }
+        if (empties == 0)
+            return scoreFinal(P, O);
+        return solveParity(P, O, alpha, beta, empties, passed);
+    }
+
+    ++nodes;
+    if (timeUp())
+        return 0;
+
+    uint64_t moves = getMoves(P, O);
+    if (!moves)
+    {
+        if (passed)
+            return scoreFinal(P, O);
+        return -solveDeep(O, P, -beta, -alpha, empties, true);
+    }
+
+    int alphaOrig = alpha;
+    uint64_t key = hashMasks(P, O);
+    TTEntry entry;
+    int hashMove = PASS;
+    if (tt != nullptr && empties >= TT_MIN_EMPTIES && tt->probe(key, entry))
+    {
+        hashMove = entry.move;
+        if (entry.depth >= empties)
+        {
+            if (entry.bound == BOUND_EXACT)
+                return entry.score;
+            if (entry.bound == BOUND_LOWER && entry.score >= beta)
+                return entry.score;
+            if (entry.bound == BOUND_UPPER && entry.score <= alpha)
+                return entry.score;
+        }
+    }
+
+    // fastest-first: fewest opponent replies (corners count as one fewer)
+    int moveList[MAX_MOVES];
+    int keys[MAX_MOVES];
+    int count = 0;
+    for (uint64_t b = moves; b; b &= b - 1)
+    {
+        int sq = firstSquare(b);
+        uint64_t flips = getFlips(P, O, sq);
+        uint64_t nextP = O & ~flips;
+        uint64_t nextO = P | flips | (1ULL << sq);
+        int keyValue = 2 * popCount(getMoves(nextP, nextO)) - ((0x8100000000000081ULL >> sq) & 1);
+        if (sq == hashMove)
+            keyValue = -SOLVE_INF;
+
+        int j = count++;
+        while (j > 0 && keys[j - 1] > keyValue)
+        {
+            keys[j] = keys[j - 1];
+            moveList[j] = moveList[j - 1];
+            --j;
+        }
+        keys[j] = keyValue;
+        moveList[j] = sq;
+    }
+
+    int bestScore = -SOLVE_INF;
+    int bestMove = PASS;
+    for (int i = 0; i < count; ++i)
+    {
+        int sq = moveList[i];
+        uint64_t flips = getFlips(P, O, sq);
+        uint64_t nextP = O & ~flips;
+        uint64_t nextO = P | flips | (1ULL << sq);
+        Empty *empty = &squares[sq];
+        removeEmpty(empty);
+        int score;
+        if (i == 0)
+        {
+            score = -solveDeep(nextP, nextO, -beta, -alpha, empties - 1, false);
+        }
+        else
+        {
+            score = -solveDeep(nextP, nextO, -alpha - 1, -alpha, empties - 1, false);
+            if (score > alpha && score < beta)
+                score = -solveDeep(nextP, nextO, -beta, -alpha, empties - 1, false);
+        }
+        restoreEmpty(empty);
+        if (stopped)
+            return 0;
+
+        if (score > bestScore)
+        {
+            bestScore = score;
+            bestMove = sq;
+            if (score > alpha)
+            {
+                alpha = score;
+                if (alpha >= beta)
+                    break;
+            }
+        }
+    }
+
+    if (tt != nullptr && empties >= TT_MIN_EMPTIES)
+    {
+        Bound bound = bestScore <= alphaOrig ? BOUND_UPPER
+            : bestScore >= beta ? BOUND_LOWER : BOUND_EXACT;
+        tt->store(key, empties, bound, bestScore, bestMove);
+    }
+    return bestScore;
+}
+
+/*
+ * Solves the position exactly for the given side. Returns the disc
+ * differential under perfect play and sets bestMove to a move achieving it
+ * (PASS if the side cannot move). If the deadline passes first, wasStopped()
+ * is true and the result must not be used.
+ */
+int EndgameSolver::solveRoot(Board &board, Side side, int &bestMove)
+{
+    uint64_t P = board.getMask(side);
+    uint64_t O = board.getMask(side == BLACK ? WHITE : BLACK);
+    int empties = 64 - popCount(P | O);
+    nodes = 0;
+    stopped = false;
+    checkCountdown = TIME_CHECK_INTERVAL;
+    setup(P, O);
+
+    bestMove = PASS;
+    uint64_t moves = getMoves(P, O);
+    if (!moves)
+        return -solveDeep(O, P, -SOLVE_INF, SOLVE_INF, empties, true);
+
+    // fastest-first at the root as well
+    int moveList[MAX_MOVES];
+    int keys[MAX_MOVES];
+    int count = 0;
+    for (uint64_t b = moves; b; b &= b - 1)
+    {
+        int sq = firstSquare(b);
+        uint64_t flips = getFlips(P, O, sq);
+        int keyValue = popCount(getMoves(O & ~flips, P | flips | (1ULL << sq)));
+        int j = count++;
+        while (j > 0 && keys[j - 1] > keyValue)
+        {
+            keys[j] = keys[j - 1];
+            moveList[j] = moveList[j - 1];
+            --j;
+        }
+        keys[j] = keyValue;
+        moveList[j] = sq;
+    }
+
+    int alpha = -SOLVE_INF;
+    int beta = SOLVE_INF;
+    for (int i = 0; i < count; ++i)
+    {
+        int sq = moveList[i];
+        uint64_t flips = getFlips(P, O, sq);
+        uint64_t nextP = O & ~flips;
+        uint64_t nextO = P | flips | (1ULL << sq);
+        Empty *empty = &squares[sq];
+        removeEmpty(empty);
+        int score;
+        if (i == 0)
+        {
+            score = -solveDeep(nextP, nextO, -beta, -alpha, empties - 1, false);
+        }
+        else
+        {
+            score = -solveDeep(nextP, nextO, -alpha - 1, -alpha, empties - 1, false);
+            if (score > alpha)
+                score = -solveDeep(nextP, nextO, -beta, -alpha, empties - 1, false);
+        }
+        restoreEmpty(empty);
+        if (stopped)
+            break;
+
+        if (score > alpha)
+        {
+            alpha = score;
+            bestMove = sq;
+        }
+    }
+    return alpha;
+}
@@ -0,0 +1,68 @@
+#ifndef __ENDGAME_H__
+#define __ENDGAME_H__
+
+#include "common.hpp"
+#include "board.hpp"
+#include "search.hpp"
+#include "tt.hpp"
+
+/*
+ * Exact endgame solver. Scores are final disc differentials (empty squares
+ * going to the winner) from the point of view of the side to move, so they
+ * lie in [-64, 64].
+ *
+ * Instead of generating moves from the full board, the solver keeps a linked
+ * list of the empty squares, sorted once by static square priority. Near the
+ * root (FASTEST_FIRST_EMPTIES or more empties) moves are tried fastest-first,
+ * i.e. the move leaving the opponent the fewest replies first, and results
+ * are cached in the transposition table. Below that, the list is walked
+ * twice: first the squares of quadrants with an odd number of empties
+ * (parity), then the rest. The last three empties use unrolled kernels.
+ */
+class EndgameSolver {
+
+private:
+    struct Empty {
+        int sq;
+        unsigned quadrant;
+        Empty *prev;
+        Empty *next;
+    };
+
+    Empty head;             // sentinel of the empty-square list
+    Empty squares[64];      // list nodes, indexed by square
+    unsigned parity;        // bit q set if quadrant q has an odd number of empties
+
+    TranspositionTable *tt; // may be nullptr
+    long long nodes;
+    bool timed;
+    SearchClock::time_point hardStop;
+    bool stopped;
+    int checkCountdown;
+
+    bool timeUp();
+    void setup(uint64_t P, uint64_t O);
+    void removeEmpty(Empty *empty);
+    void restoreEmpty(Empty *empty);
+
+    int solveDeep(uint64_t P, uint64_t O, int alpha, int beta, int empties, bool passed);
+    int solveParity(uint64_t P, uint64_t O, int alpha, int beta, int empties, bool passed);
+    int solve3(uint64_t P, uint64_t O, int alpha, int beta, int sq1, int sq2, int sq3, bool passed);
+    int solve2(uint64_t P, uint64_t O, int alpha, int beta, int sq1, int sq2, bool passed);
+    int solve1(uint64_t P, uint64_t O, int sq);
+
+public:
+    EndgameSolver(TranspositionTable *table = nullptr);
+    ~EndgameSolver();
+
+    // abandon the solve once this time has passed
+    void setDeadline(SearchClock::time_point deadline);
+
+    // perfect-play disc differential for side; bestMove is set to a move id or PASS
+    int solveRoot(Board &board, Side side, int &bestMove);
+
+    bool wasStopped() { return stopped; }
+    long long getNodes() { return nodes; }
+};
+
+#endif
@@ -0,0 +1,305 @@
+#include "eval.hpp"
+#include <cstdio>
+#include <cstring>
+
+// Longest pattern, in squares.
+static const int MAX_PATTERN_SQUARES = 10;
+// Most pattern instances any one square belongs to.
+static const int MAX_SQUARE_PATTERNS = 8;
+
+/*
+ * One instance of each pattern type; the others are its images under the
+ * board symmetries, with the squares kept in corresponding order so that
+ * they can share the weight table.
+ */
+static const int BASE_SQUARES[NUM_PATTERN_TYPES][MAX_PATTERN_SQUARES + 1] = {
+    { 9, 0, 1, 2, 3, 4, 5, 6, 7, 14, -1 },
+    { 0, 1, 2, 8, 9, 10, 16, 17, 18, -1 },
+    { 0, 1, 2, 3, 4, 8, 9, 10, 11, 12, -1 },
+    { 0, 9, 18, 27, 36, 45, 54, 63, -1 },
+    { 1, 10, 19, 28, 37, 46, 55, -1 },
+    { 2, 11, 20, 29, 38, 47, -1 },
+    { 3, 12, 21, 30, 39, -1 },
+    { 4, 13, 22, 31, -1 }
+};
+
+/*
+ * File header of a weights file, followed by the int16 pattern weights of
+ * each stage, then the NUM_FEATURES int16 feature weights of each stage and
+ * the int16 parity weight of each stage. Files of the first format have only
+ * the mobility weight of each stage in place of the feature weights; they
+ * are still read, with the other features unweighted.
+ */
+struct EvalHeader {
+    char magic[8];
+    uint32_t stages;
+    uint32_t stageSize;
+};
+
+static const char EVAL_MAGIC[8] = { 'O', 'T', 'H', 'E', 'V', 'A', 'L', '2' };
+static const char EVAL_MAGIC_MOBILITY_ONLY[8] = { 'O', 'T', 'H', 'E', 'V', 'A', 'L', '1' };
+
+// Shape of the patterns, filled in before main() runs.
+static int patternLength[NUM_PATTERN_TYPES];
+static int patternOffset[NUM_PATTERN_TYPES];   // of the type's table within a stage
+static int stageSize;
+static int instanceType[NUM_PATTERNS];
+static int instanceOffset[NUM_PATTERNS];
+static int instanceSquares[NUM_PATTERNS][MAX_PATTERN_SQUARES];
+// the instances each square belongs to, and its digit's weight 3^k there
+static int squarePatternCount[64];
+static int squarePattern[64][MAX_SQUARE_PATTERNS];
+static int squarePower[64][MAX_SQUARE_PATTERNS];
+
+/*
+ * Lays the pattern instances out on the board: each base pattern under all 8
+ * symmetries, dropping images that cover the same squares as an earlier one.
+ */
+static struct PatternInit {
+    PatternInit() {
+        int instances = 0;
+        stageSize = 0;
+        for (int type = 0; type < NUM_PATTERN_TYPES; type++) {
+            int length = 0;
+            while (BASE_SQUARES[type][length] >= 0)
+                length++;
+            int size = 1;
+            for (int k = 0; k < length; k++)
+                size *= 3;
+            patternLength[type] = length;
+            patternOffset[type] = stageSize;
+            stageSize += size;
+
+            vector<uint64_t> covered;
+            for (int symmetry = 0; symmetry < 8; symmetry++) {
+                uint64_t mask = 0;
+                for (int k = 0; k < length; k++)
+                    mask |= 1ULL << symmetricSquare(BASE_SQUARES[type][k], symmetry);
+                bool seen = false;
+                for (uint64_t other : covered)
+                    seen = seen || other == mask;
+                if (seen)
+                    continue;
+                covered.push_back(mask);
+
+                instanceType[instances] = type;
+                instanceOffset[instances] = patternOffset[type];
+                int power = 1;
+                for (int k = 0; k < length; k++) {
+                    int sq = symmetricSquare(BASE_SQUARES[type][k], symmetry);
+                    instanceSquares[instances][k] = sq;
+                    squarePattern[sq][squarePatternCount[sq]] = instances;
+                    squarePower[sq][squarePatternCount[sq]] = power;
+                    squarePatternCount[sq]++;
+                    power *= 3;
+                }
+                instances++;
+            }
+        }
+    }
+} patternInit;
+
+/*
+ * Make an evaluator with the default weights.
+ */
+PatternEval::PatternEval() {
+    seedDefaults();
+}
+
+/*
+ * Spreads the square weights over the patterns: every square's weight goes
+ * to the first pattern type covering it, split evenly over that type's
+ * instances containing the square. Summed over all instances, the tables
+ * then give back the square-weight score of calcPositionalScore(), in every
+ * stage.
+ */
+void PatternEval::seedDefaults() {
+    int owner[64];
+    int coverage[64];
+    for (int sq = 0; sq < 64; sq++) {
+        owner[sq] = -1;
+        coverage[sq] = 0;
+    }
+    for (int i = 0; i < NUM_PATTERNS; i++) {
+        int type = instanceType[i];
+        for (int k = 0; k < patternLength[type]; k++) {
+            int sq = instanceSquares[i][k];
+            if (owner[sq] < 0)
+                owner[sq] = type;
+            if (owner[sq] == type)
+                coverage[sq]++;
+        }
+    }
+
+    weights.assign((size_t) NUM_STAGES * stageSize, 0);
+    for (int type = 0; type < NUM_PATTERN_TYPES; type++) {
+        int length = patternLength[type];
+        int16_t *table = weights.data() + patternOffset[type];
+        int size = 1;
+        for (int k = 0; k < length; k++)
+            size *= 3;
+
+        for (int index = 0; index < size; index++) {
+            int score = 0;
+            for (int k = 0, rest = index; k < length; k++, rest /= 3) {
+                int sq = BASE_SQUARES[type][k];
+                if (owner[sq] != type || rest % 3 == 0)
+                    continue;
+                int share = SQUARE_WEIGHTS[sq] / coverage[sq];
+                score += (rest % 3 == 1) ? share : -share;
+            }
+            table[index] = score;
+        }
+    }
+    for (int stage = 1; stage < NUM_STAGES; stage++)
+        memcpy(weights.data() + (size_t) stage * stageSize, weights.data(), stageSize * sizeof(int16_t));
+
+    for (int stage = 0; stage < NUM_STAGES; stage++) {
+        for (int f = 0; f < NUM_FEATURES; f++)
+            featureWeight[stage][f] = 0;
+        featureWeight[stage][FEATURE_MOBILITY] = MOBILITY_WEIGHT;
+        parityWeight[stage] = 0;
+    }
+}
+
+/*
+ * Reads a weights file. The file must have been written for the same
+ * patterns and stages.
+ */
+bool PatternEval::load(const char *path) {
+    FILE *file = fopen(path, "rb");
+    if (file == nullptr)
+        return false;
+
+    EvalHeader header;
+    vector<int16_t> table((size_t) NUM_STAGES * stageSize);
+    int16_t features[NUM_STAGES][NUM_FEATURES] = {};
+    int16_t parity[NUM_STAGES];
+    bool ok = fread(&header, sizeof(header), 1, file) == 1
+        && header.stages == (uint32_t) NUM_STAGES
+        && header.stageSize == (uint32_t) stageSize
+        && fread(table.data(), sizeof(int16_t), table.size(), file) == table.size();
+    if (ok && memcmp(header.magic, EVAL_MAGIC, sizeof(EVAL_MAGIC)) == 0)
+        ok = fread(features, sizeof(int16_t), NUM_STAGES * NUM_FEATURES, file) == (size_t) (NUM_STAGES * NUM_FEATURES);
+    else if (ok && memcmp(header.magic, EVAL_MAGIC_MOBILITY_ONLY, sizeof(EVAL_MAGIC)) == 0) {
+        int16_t mobility[NUM_STAGES];
+        ok = fread(mobility, sizeof(int16_t), NUM_STAGES, file) == (size_t) NUM_STAGES;
+        for (int stage = 0; stage < NUM_STAGES; stage++)
+            features[stage][FEATURE_MOBILITY] = mobility[stage];
+    }
+    else
+        ok = false;
+    ok = ok && fread(parity, sizeof(int16_t), NUM_STAGES, file) == (size_t) NUM_STAGES;
+    fclose(file);
+    if (!ok)
+        return false;
+
+    weights.swap(table);
+    memcpy(featureWeight, features, sizeof(features));
+    memcpy(parityWeight, parity, sizeof(parity));
+    return true;
+}
+
+/*
+ * Writes the weights with the header load() checks.
+ */
+bool PatternEval::save(const char *path) const {
+    FILE *file = fopen(path, "wb");
+    if (file == nullptr)
+        return false;
+
+    EvalHeader header;
+    memcpy(header.magic, EVAL_MAGIC, sizeof(EVAL_MAGIC));
+    header.stages = NUM_STAGES;
+    header.stageSize = stageSize;
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1
+        && fwrite(weights.data(), sizeof(int16_t), weights.size(), file) == weights.size()
+        && fwrite(featureWeight, sizeof(int16_t), NUM_STAGES * NUM_FEATURES, file) == (size_t) (NUM_STAGES * NUM_FEATURES)
+        && fwrite(parityWeight, sizeof(int16_t), NUM_STAGES, file) == (size_t) NUM_STAGES;
+    return fclose(file) == 0 && ok;
+}
+
+int PatternEval::tableSize() {
+    return stageSize;
+}
+
+int PatternEval::weightIndex(const PatternState &state, int instance) {
+    return instanceOffset[instance] + state.index[instance];
+}
+
+/*
+ * Weights stage of a position with discs discs on the board.
+ */
+int PatternEval::stageOf(int discs) {
+    int stage = (discs - 4) / STAGE_PLIES;
+    return stage < NUM_STAGES ? stage : NUM_STAGES - 1;
+}
+
+void PatternEval::initState(Board &board, PatternState &state) {
+    uint64_t black = board.getMask(BLACK);
+    uint64_t white = board.getMask(WHITE);
+    for (int i = 0; i < NUM_PATTERNS; i++) {
+        int index = 0;
+        for (int k = patternLength[instanceType[i]] - 1; k >= 0; k--) {
+            int sq = instanceSquares[i][k];
+            index = 3 * index + (((black >> sq) & 1) ? 1 : ((white >> sq) & 1) ? 2 : 0);
+        }
+        state.index[i] = index;
+    }
+}
+
+/*
+ * The played square goes from empty (0) to the mover's digit; every flipped
+ * disc goes from the other colour's digit to the mover's, i.e. by -1 when
+ * black flips white and by +1 when white flips black.
+ */
+void PatternEval::update(PatternState &state, int moveId, uint64_t flips, Side side) {
+    if (moveId == PASS)
+        return;
+
+    int placed = (side == BLACK) ? 1 : 2;
+    for (int j = 0; j < squarePatternCount[moveId]; j++)
+        state.index[squarePattern[moveId][j]] += placed * squarePower[moveId][j];
+
+    int flipped = (side == BLACK) ? -1 : 1;
+    for (uint64_t b = flips; b; b &= b - 1) {
+        int sq = firstSquare(b);
+        for (int j = 0; j < squarePatternCount[sq]; j++)
+            state.index[squarePattern[sq][j]] += flipped * squarePower[sq][j];
+    }
+}
+
+/*
+ * Sum of the pattern weights of the position's stage, turned round for
+ * white, plus the weighted features (each own minus opponent) and parity
+ * (+1 when the side to move would get the last move, -1 otherwise).
+ */
+int PatternEval::evaluate(const PatternState &state, uint64_t black, uint64_t white, Side side) const {
+    uint64_t mine = (side == BLACK) ? black : white;
+    uint64_t theirs = (side == BLACK) ? white : black;
+    int mobility = popCount(getMoves(mine, theirs)) - popCount(getMoves(theirs, mine));
+    return evaluate(state, mine, theirs, side, mobility);
+}
+
+int PatternEval::evaluate(const PatternState &state, uint64_t mine, uint64_t theirs, Side side, int mobility) const {
+    int discs = popCount(mine | theirs);
+    int stage = stageOf(discs);
+    const int16_t *table = weights.data() + (size_t) stage * stageSize;
+    int score = 0;
+    for (int i = 0; i < NUM_PATTERNS; i++)
+        score += table[instanceOffset[i] + state.index[i]];
+    if (side == WHITE)
+        score = -score;
+
+    int parity = ((64 - discs) & 1) ? 1 : -1;
+    const int16_t *weight = featureWeight[stage];
+    score += weight[FEATURE_MOBILITY] * mobility + parityWeight[stage] * parity;
+    if ((weight[FEATURE_POTENTIAL_MOBILITY] | weight[FEATURE_FRONTIER] | weight[FEATURE_STABLE]) == 0)
+        return score;
+
+    FeatureVector features;
+    computeFeatures(mine, theirs, mobility, features);
+    for (int f = FEATURE_POTENTIAL_MOBILITY; f < NUM_FEATURES; f++)
+        score += weight[f] * features.value[f];
+    return score;
+}
@@ -0,0 +1,102 @@
+#ifndef __EVAL_H__
+#define __EVAL_H__
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "common.hpp"
+#include "board.hpp"
+#include "features.hpp"
+
+using namespace std;
+
+/*
+ * Pattern types. Every type has one weight table shared by all of its
+ * symmetric instances on the board.
+ */
+enum PatternType {
+    PATTERN_EDGE_2X,    // an edge plus its two X-squares (10 squares, 4 instances)
+    PATTERN_CORNER_3X3, // 3x3 block in a corner (9 squares, 4 instances)
+    PATTERN_CORNER_2X5, // 2x5 block along an edge from a corner (10 squares, 8 instances)
+    PATTERN_DIAG_8,     // the two long diagonals
+    PATTERN_DIAG_7,
+    PATTERN_DIAG_6,
+    PATTERN_DIAG_5,
+    PATTERN_DIAG_4,
+    NUM_PATTERN_TYPES
+};
+
+// Pattern instances on the board, over all types.
+const int NUM_PATTERNS = 34;
+// Weight tables are kept per game stage of STAGE_PLIES plies.
+const int NUM_STAGES = 12;
+const int STAGE_PLIES = 5;
+
+/*
+ * The index of every pattern instance in the current position: the squares
+ * of the instance read as base-3 digits (0 empty, 1 black, 2 white), so the
+ * indices do not depend on the side to move.
+ */
+struct PatternState {
+    uint16_t index[NUM_PATTERNS];
+};
+
+/*
+ * Pattern-based evaluation. The score of a position is the sum of one table
+ * lookup per pattern instance, plus a weighted sum of the board features
+ * (mobility, potential mobility, frontier and stable discs, see
+ * features.hpp) and a parity term, with a set of weights for each game
+ * stage. Features other than mobility are computed only in stages where
+ * they have a nonzero weight.
+ *
+ * The instance indices live in a PatternState that the search updates
+ * incrementally: update() adjusts only the instances touching the played
+ * square and the flipped discs, so a leaf costs NUM_PATTERNS lookups and two
+ * move generations.
+ *
+ * Weights are read from a file written by the training tools. Without one,
+ * they are seeded from the square-weight table, so that the evaluation
+ * matches Board::calcPositionalScore() exactly.
+ */
+class PatternEval {
+
+private:
+    // weights[stage][offset of type + index], black's point of view
+    vector<int16_t> weights;
+    int16_t featureWeight[NUM_STAGES][NUM_FEATURES];
+    int16_t parityWeight[NUM_STAGES];
+
+public:
+    PatternEval();
+
+    // replaces the weights with the ones in the file; false (weights unchanged) if it cannot be read
+    bool load(const char *path);
+    // writes the weights in the format load() reads; false if the file cannot be written
+    bool save(const char *path) const;
+    // the weights derived from SQUARE_WEIGHTS and MOBILITY_WEIGHT, with the other features unweighted
+    void seedDefaults();
+
+    // computes every index of the position from scratch
+    static void initState(Board &board, PatternState &state);
+    // adjusts the indices for side playing moveId and flipping flips; PASS changes nothing
+    static void update(PatternState &state, int moveId, uint64_t flips, Side side);
+
+    // score for the side to move
+    int evaluate(const PatternState &state, uint64_t black, uint64_t white, Side side) const;
+    // the same, for the discs mine and theirs of the side to move and the other side and
+    // the mobility (own minus opponent moves) already known
+    int evaluate(const PatternState &state, uint64_t mine, uint64_t theirs, Side side, int mobility) const;
+
+    // layout of the weights, for the training tools: each stage has a table
+    // of tableSize() pattern weights, and instance i of a position uses the
+    // one at weightIndex(state, i)
+    static int tableSize();
+    static int weightIndex(const PatternState &state, int instance);
+    static int stageOf(int discs);
+    int16_t *table(int stage) { return weights.data() + (size_t) stage * tableSize(); }
+    int16_t &feature(int stage, Feature f) { return featureWeight[stage][f]; }
+    int16_t &mobility(int stage) { return featureWeight[stage][FEATURE_MOBILITY]; }
+    int16_t &parity(int stage) { return parityWeight[stage]; }
+};
+
+#endif
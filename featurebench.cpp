@@ -0,0 +1,194 @@
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <random>
+#include <vector>
+#include "board.hpp"
+#include "features.hpp"
+using namespace std;
+
+/*
+ * Feature kernel benchmark and check.
+ *
+ * Collects positions from random games, checks every kernel of
+ * features.hpp on them against a plain square-by-square version, then
+ * times each kernel and the whole feature vector in nanoseconds per call.
+ */
+
+typedef chrono::steady_clock BenchClock;
+
+struct Position {
+    uint64_t P;
+    uint64_t O;
+};
+
+static const int DX[8] = { 1, 1, 0, -1, -1, -1, 0, 1 };
+static const int DY[8] = { 0, 1, 1, 1, 0, -1, -1, -1 };
+
+static bool inside(int x, int y) {
+    return x >= 0 && x < 8 && y >= 0 && y < 8;
+}
+
+static bool has(uint64_t b, int x, int y) {
+    return inside(x, y) && ((b >> (x + 8 * y)) & 1);
+}
+
+/*
+ * The kernels written out square by square.
+ */
+static uint64_t slowNeighbours(uint64_t b) {
+    uint64_t result = 0;
+    for (int sq = 0; sq < 64; sq++)
+        for (int d = 0; d < 8; d++)
+            if (!((b >> sq) & 1) && has(b, sq % 8 + DX[d], sq / 8 + DY[d]))
+                result |= 1ULL << sq;
+    return result;
+}
+
+static bool lineFull(uint64_t filled, int x, int y, int d) {
+    for (int sign = -1; sign <= 1; sign += 2)
+        for (int i = 1; inside(x + sign * i * DX[d], y + sign * i * DY[d]); i++)
+            if (!has(filled, x + sign * i * DX[d], y + sign * i * DY[d]))
+                return false;
+    return true;
+}
+
+static uint64_t slowStable(uint64_t P, uint64_t O) {
+    uint64_t stable = 0;
+    for (bool grew = true; grew; ) {
+        grew = false;
+        for (int sq = 0; sq < 64; sq++) {
+            int x = sq % 8, y = sq / 8;
+            if (!((P >> sq) & 1) || ((stable >> sq) & 1))
+                continue;
+            bool all = true;
+            for (int d = 0; d < 4 && all; d++) {
+                bool wall = !inside(x + DX[d], y + DY[d]) || !inside(x - DX[d], y - DY[d]);
+                bool anchored = has(stable, x + DX[d], y + DY[d]) || has(stable, x - DX[d], y - DY[d]);
+                all = wall || anchored || lineFull(P | O, x, y, d);
+            }
+            if (all) {
+                stable |= 1ULL << sq;
+                grew = true;
+            }
+        }
+    }
+    return stable;
+}
+
+/*
+ * Positions met in random games, for the side to move.
+ */
+static vector<Position> randomPositions(int count, unsigned seed) {
+    vector<Position> positions;
+    mt19937 random(seed);
+    while ((int) positions.size() < count) {
+        uint64_t P = 0x0000000810000000ULL;
+        uint64_t O = 0x0000001008000000ULL;
+        for (int passes = 0; passes < 2 && (int) positions.size() < count; ) {
+            uint64_t moves = getMoves(P, O);
+            if (moves == 0) {
+                passes++;
+            }
+            else {
+                passes = 0;
+                int choice = random() % popCount(moves);
+                for (int i = 0; i < choice; i++)
+                    moves &= moves - 1;
+                int sq = firstSquare(moves);
+                uint64_t flips = getFlips(P, O, sq);
+                P |= flips | (1ULL << sq);
+                O &= ~flips;
+            }
+            swap(P, O);
+            positions.push_back({ P, O });
+        }
+    }
+    return positions;
+}
+
+static bool check(const vector<Position> &positions) {
+    for (const Position &p : positions) {
+        uint64_t empty = ~(p.P | p.O);
+        if (neighbours(p.P) != slowNeighbours(p.P)
+                || stableDiscs(p.P, p.O) != slowStable(p.P, p.O)
+                || frontierDiscs(p.P, p.O) != (p.P & slowNeighbours(empty))
+                || potentialMoves(p.P, p.O) != (empty & slowNeighbours(p.O))) {
+            printf("mismatch: P %016llx O %016llx\n", (unsigned long long) p.P, (unsigned long long) p.O);
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Times kernel over all positions, rounds times over, and prints the cost
+ * of one call. The results are summed so that the calls are not dropped.
+ */
+template <typename Kernel>
+static void bench(const char *name, const vector<Position> &positions, int rounds, Kernel kernel) {
+    uint64_t sink = 0;
+    BenchClock::time_point begin = BenchClock::now();
+    for (int r = 0; r < rounds; r++)
+        for (const Position &p : positions)
+            sink += kernel(p.P, p.O);
+    double seconds = chrono::duration<double>(BenchClock::now() - begin).count();
+    printf("%-20s %7.2f ns/call (%llx)\n", name, seconds * 1e9 / ((double) rounds * positions.size()),
+           (unsigned long long) (sink & 0xFFFF));
+}
+
+static void usage(const char *name) {
+    cerr << "usage: " << name << " [-n positions] [-r rounds] [-s seed]" << endl
+         << "  -n  positions from random games (default 100000)" << endl
+         << "  -r  timed passes over the positions (default 20)" << endl
+         << "  -s  seed of the random games (default 1)" << endl;
+    exit(-1);
+}
+
+int main(int argc, char *argv[]) {
+    int count = 100000;
+    int rounds = 20;
+    unsigned seed = 1;
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (!strcmp(argv[i], "-n") && hasValue)
+            count = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-r") && hasValue)
+            rounds = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-s") && hasValue)
+            seed = (unsigned) atoi(argv[++i]);
+        else
+            usage(argv[0]);
+    }
+    if (count < 1 || rounds < 1)
+        usage(argv[0]);
+
+    vector<Position> positions = randomPositions(count, seed);
+    if (!check(positions))
+        return 1;
+    printf("%d positions checked\n", count);
+
+    bench("mobility", positions, rounds, [](uint64_t P, uint64_t O) {
+        return (uint64_t) (popCount(getMoves(P, O)) - popCount(getMoves(O, P)));
+    });
+    bench("potential mobility", positions, rounds, [](uint64_t P, uint64_t O) {
+        return (uint64_t) (popCount(potentialMoves(P, O)) - popCount(potentialMoves(O, P)));
+    });
+    bench("frontier", positions, rounds, [](uint64_t P, uint64_t O) {
+        return (uint64_t) (popCount(frontierDiscs(P, O)) - popCount(frontierDiscs(O, P)));
+    });
+    bench("stable", positions, rounds, [](uint64_t P, uint64_t O) {
+        return (uint64_t) (popCount(stableDiscs(P, O)) - popCount(stableDiscs(O, P)));
+    });
+    bench("feature vector", positions, rounds, [](uint64_t P, uint64_t O) {
+        FeatureVector features;
+        computeFeatures(P, O, features);
+        uint64_t sum = 0;
+        for (int f = 0; f < NUM_FEATURES; f++)
+            sum += features.value[f];
+        return sum;
+    });
+    return 0;
+}
@@ -0,0 +1,138 @@
+#ifndef __FEATURES_H__
+#define __FEATURES_H__
+
+#include <cstdint>
+#include "bitboard.hpp"
+
+/*
+ * Whole-board feature kernels for the evaluation.
+ *
+ * Like the kernels in bitboard.hpp these work on the discs of the side to
+ * move P and of the other side O, with shifts and masks only: no loops over
+ * squares or lines, so that the full feature vector of a position costs a
+ * few tens of nanoseconds (see featurebench).
+ */
+
+const uint64_t FILE_A = 0x0101010101010101ULL;
+const uint64_t FILE_H = 0x8080808080808080ULL;
+const uint64_t RANK_1 = 0x00000000000000FFULL;
+const uint64_t RANK_8 = 0xFF00000000000000ULL;
+const uint64_t BOARD_EDGE = FILE_A | FILE_H | RANK_1 | RANK_8;
+
+/*
+ * Features of a position, each counted for the side to move minus the other
+ * side. The weights of the evaluation are kept in the same order.
+ */
+enum Feature {
+    FEATURE_MOBILITY,           // legal moves
+    FEATURE_POTENTIAL_MOBILITY, // empty squares next to a disc of the other side
+    FEATURE_FRONTIER,           // own discs next to an empty square
+    FEATURE_STABLE,             // own discs that can never be flipped
+    NUM_FEATURES
+};
+
+struct FeatureVector {
+    int value[NUM_FEATURES];
+};
+
+/*
+ * Squares next to any square of b, in any of the 8 directions.
+ */
+inline uint64_t neighbours(uint64_t b) {
+    uint64_t row = b | ((b << 1) & ~FILE_A) | ((b >> 1) & ~FILE_H);
+    return (row | (row << 8) | (row >> 8)) & ~b;
+}
+
+/*
+ * Squares on a completely filled line along each axis. A disc on such a
+ * line cannot be flanked along it any more.
+ */
+inline uint64_t fullRows(uint64_t filled) {
+    uint64_t h = filled & (filled >> 4);
+    h &= h >> 2;
+    h &= h >> 1;
+    return (h & FILE_A) * 0xFF;
+}
+
+inline uint64_t fullColumns(uint64_t filled) {
+    uint64_t v = filled & (filled >> 32);
+    v &= v >> 16;
+    v &= v >> 8;
+    return (v & RANK_1) * FILE_A;
+}
+
+// the diagonals running from a1 towards h8 (+9) and from h1 towards a8 (+7):
+// the squares an empty square reaches along them are the unfilled ones
+inline uint64_t fullDiagonals9(uint64_t filled) {
+    uint64_t empty = ~filled;
+    return ~(fillUp(empty, ~FILE_A, 9) | fillDown(empty, ~FILE_H, 9));
+}
+
+inline uint64_t fullDiagonals7(uint64_t filled) {
+    uint64_t empty = ~filled;
+    return ~(fillUp(empty, ~FILE_H, 7) | fillDown(empty, ~FILE_A, 7));
+}
+
+/*
+ * Discs of P that can never be flipped. A disc is stable along an axis when
+ * its line along the axis is full, or it lies on the board edge at the end
+ * of the line, or it has a stable disc of its own colour next to it on the
+ * line; it is stable when that holds for all four axes. Starting from the
+ * corners, the set is grown until nothing changes. This finds every disc
+ * held by full lines and by chains anchored on the corners and edges, which
+ * is a safe subset of the truly stable discs.
+ */
+inline uint64_t stableDiscs(uint64_t P, uint64_t O) {
+    uint64_t filled = P | O;
+    uint64_t horizontal = fullRows(filled) | FILE_A | FILE_H;
+    uint64_t vertical = fullColumns(filled) | RANK_1 | RANK_8;
+    uint64_t diagonal9 = fullDiagonals9(filled) | BOARD_EDGE;
+    uint64_t diagonal7 = fullDiagonals7(filled) | BOARD_EDGE;
+    uint64_t candidates = P & horizontal & vertical & diagonal9 & diagonal7;
+
+    uint64_t stable = 0;
+    while (candidates != stable) {
+        stable = candidates;
+        candidates = P
+            & (horizontal | ((stable << 1) & ~FILE_A) | ((stable >> 1) & ~FILE_H))
+            & (vertical | (stable << 8) | (stable >> 8))
+            & (diagonal9 | ((stable << 9) & ~FILE_A) | ((stable >> 9) & ~FILE_H))
+            & (diagonal7 | ((stable << 7) & ~FILE_H) | ((stable >> 7) & ~FILE_A));
+        candidates |= stable;
+    }
+    return stable;
+}
+
+/*
+ * Discs of P next to an empty square.
+ */
+inline uint64_t frontierDiscs(uint64_t P, uint64_t O) {
+    return P & neighbours(~(P | O));
+}
+
+/*
+ * Empty squares next to a disc of O: the squares P may later be able to
+ * play on.
+ */
+inline uint64_t potentialMoves(uint64_t P, uint64_t O) {
+    return neighbours(O) & ~(P | O);
+}
+
+/*
+ * The feature vector of the position, for P to move, with the mobility
+ * (own minus opponent legal moves) already known.
+ */
+inline void computeFeatures(uint64_t P, uint64_t O, int mobility, FeatureVector &features) {
+    uint64_t empty = ~(P | O);
+    uint64_t nextToEmpty = neighbours(empty);
+    features.value[FEATURE_MOBILITY] = mobility;
+    features.value[FEATURE_POTENTIAL_MOBILITY] = popCount(empty & neighbours(O)) - popCount(empty & neighbours(P));
+    features.value[FEATURE_FRONTIER] = popCount(P & nextToEmpty) - popCount(O & nextToEmpty);
+    features.value[FEATURE_STABLE] = popCount(stableDiscs(P, O)) - popCount(stableDiscs(O, P));
+}
+
+inline void computeFeatures(uint64_t P, uint64_t O, FeatureVector &features) {
+    computeFeatures(P, O, popCount(getMoves(P, O)) - popCount(getMoves(O, P)), features);
+}
+
+#endif
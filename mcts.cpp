@@ -0,0 +1,368 @@
+#include "mcts.hpp"
+#include <climits>
+#include <cmath>
+#include <new>
+#include <thread>
+#include <vector>
+#include <sys/mman.h>
+
+// Node states: not yet expanded, claimed by a thread that is expanding it,
+// and expanded (firstChild and childCount are valid).
+static const uint8_t NODE_LEAF = 0;
+static const uint8_t NODE_EXPANDING = 1;
+static const uint8_t NODE_EXPANDED = 2;
+
+// A leaf gets children once it has been visited this often, which keeps
+// the tree to about one new node per playout.
+static const int EXPAND_VISITS = 8;
+// Exploration constant of UCT, for results scaled to [0, 1].
+static const double UCT_EXPLORATION = 0.7;
+// Playouts a thread counts up before adding them to the shared total.
+static const int PLAYOUT_BATCH = 64;
+
+static const uint64_t CORNERS = 0x8100000000000081ULL;
+
+/*
+ * xorshift64*: a fast per-thread random number generator.
+ */
+static inline uint64_t nextRandom(uint64_t &state) {
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 2685821657736338717ULL;
+}
+
+/*
+ * Plays the game out from P to move against O: a corner whenever one is
+ * legal, else a random move. Returns the result for P in half-points.
+ */
+static int playout(uint64_t P, uint64_t O, uint64_t &random) {
+    bool swapped = false;
+    while (true) {
+        uint64_t moves = getMoves(P, O);
+        if (moves == 0) {
+            if (getMoves(O, P) == 0)
+                break;
+            std::swap(P, O);
+            swapped = !swapped;
+            continue;
+        }
+
+        uint64_t choice = (moves & CORNERS) ? (moves & CORNERS) : moves;
+        for (int k = (int) ((nextRandom(random) >> 32) % popCount(choice)); k > 0; k--)
+            choice &= choice - 1;
+        int sq = firstSquare(choice);
+        uint64_t flips = getFlips(P, O, sq);
+        P |= flips | (1ULL << sq);
+        O &= ~flips;
+        std::swap(P, O);
+        swapped = !swapped;
+    }
+
+    int mine = popCount(swapped ? O : P);
+    int theirs = popCount(swapped ? P : O);
+    return mine > theirs ? 2 : mine == theirs ? 1 : 0;
+}
+
+/*
+ * Plays moveId (or PASS) for P; afterwards P is the side to move again.
+ */
+static inline void playMove(uint64_t &P, uint64_t &O, int moveId) {
+    if (moveId != PASS) {
+        uint64_t flips = getFlips(P, O, moveId);
+        P |= flips | (1ULL << moveId);
+        O &= ~flips;
+    }
+    std::swap(P, O);
+}
+
+static void copyNode(const MctsNode &from, MctsNode &to) {
+    to.visits.store(from.visits.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    to.wins.store(from.wins.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    to.firstChild = from.firstChild;
+    to.move = from.move;
+    to.childCount = from.childCount;
+    to.state.store(from.state.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+/*
+ * Maps a pool of about the given size for the given number of threads. The
+ * pages are only backed as the tree grows into them.
+ */
+MctsSearch::MctsSearch(int threads, size_t megabytes) {
+    halfCapacity = megabytes * 1024 * 1024 / 2 / sizeof(MctsNode);
+    if (halfCapacity < MAX_MOVES + 1)
+        halfCapacity = MAX_MOVES + 1;
+    mappingSize = 2 * halfCapacity * sizeof(MctsNode);
+    void *memory = mmap(nullptr, mappingSize, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (memory == MAP_FAILED)
+        throw std::bad_alloc();
+    halves[0] = static_cast<MctsNode *>(memory);
+    halves[1] = halves[0] + halfCapacity;
+
+    this->threads = threads < 1 ? 1 : threads;
+    active = 0;
+    top = 0;
+    hasTree = false;
+    stop = false;
+    playouts = 0;
+    maxPlayouts = 0;
+}
+
+/*
+ * Destructor for the search.
+ */
+MctsSearch::~MctsSearch() {
+    munmap(halves[0], mappingSize);
+}
+
+/*
+ * Starts a new tree of the one position.
+ */
+void MctsSearch::resetTree(uint64_t black, uint64_t white, Side side) {
+    MctsNode &root = nodes()[0];
+    root.visits = 0;
+    root.wins = 0;
+    root.firstChild = 0;
+    root.move = PASS;
+    root.childCount = 0;
+    root.state = NODE_LEAF;
+    top = 1;
+    hasTree = true;
+    rootBlack = black;
+    rootWhite = white;
+    rootSide = side;
+}
+
+/*
+ * Looks for the position at the root and the two plies below it. If it is
+ * there, its subtree becomes the tree, copied breadth first into the other
+ * half of the pool (Cheney's algorithm: the copy is its own queue).
+ */
+bool MctsSearch::reuseTree(uint64_t black, uint64_t white, Side side) {
+    if (!hasTree)
+        return false;
+    MctsNode *from = nodes();
+    uint64_t P = (rootSide == BLACK) ? rootBlack : rootWhite;
+    uint64_t O = (rootSide == BLACK) ? rootWhite : rootBlack;
+    uint64_t mine = (side == BLACK) ? black : white;
+    uint64_t theirs = (side == BLACK) ? white : black;
+    if (rootSide == side && P == mine && O == theirs)
+        return true;
+
+    long long found = -1;
+    if (from[0].state == NODE_EXPANDED) {
+        for (int c = 0; c < from[0].childCount && found < 0; c++) {
+            const MctsNode &child = from[from[0].firstChild + c];
+            uint64_t childP = P, childO = O;
+            playMove(childP, childO, child.move);
+            if (rootSide != side && childP == mine && childO == theirs)
+                found = from[0].firstChild + c;
+            if (child.state != NODE_EXPANDED)
+                continue;
+            for (int g = 0; g < child.childCount && found < 0; g++) {
+                const MctsNode &grandchild = from[child.firstChild + g];
+                uint64_t nextP = childP, nextO = childO;
+                playMove(nextP, nextO, grandchild.move);
+                if (rootSide == side && nextP == mine && nextO == theirs)
+                    found = child.firstChild + g;
+            }
+        }
+    }
+    if (found < 0)
+        return false;
+
+    MctsNode *to = halves[1 - active];
+    copyNode(from[found], to[0]);
+    size_t next = 1;
+    for (size_t scan = 0; scan < next; scan++) {
+        MctsNode &node = to[scan];
+        if (node.state != NODE_EXPANDED) {
+            node.state = NODE_LEAF;
+            continue;
+        }
+        uint32_t old = node.firstChild;
+        node.firstChild = (uint32_t) next;
+        for (int c = 0; c < node.childCount; c++)
+            copyNode(from[old + c], to[next + c]);
+        next += node.childCount;
+    }
+
+    active = 1 - active;
+    top = next;
+    rootBlack = black;
+    rootWhite = white;
+    rootSide = side;
+    return true;
+}
+
+/*
+ * Gives node one child per legal move of mine (or a lone PASS); a finished
+ * game gets none. Called by the thread that claimed the node. If the pool is
+ * full the node stays a leaf.
+ */
+void MctsSearch::expand(MctsNode &node, uint64_t mine, uint64_t theirs) {
+    uint64_t moves = getMoves(mine, theirs);
+    int count = moves ? popCount(moves) : (getMoves(theirs, mine) ? 1 : 0);
+    size_t first = 0;
+    if (count > 0) {
+        first = top.fetch_add(count);
+        if (first + count > halfCapacity) {
+            node.state.store(NODE_LEAF, std::memory_order_release);
+            return;
+        }
+    }
+
+    MctsNode *pool = nodes();
+    for (int c = 0; c < count; c++) {
+        MctsNode &child = pool[first + c];
+        child.visits.store(0, std::memory_order_relaxed);
+        child.wins.store(0, std::memory_order_relaxed);
+        child.firstChild = 0;
+        child.move = moves ? firstSquare(moves) : PASS;
+        child.childCount = 0;
+        child.state.store(NODE_LEAF, std::memory_order_relaxed);
+        moves &= moves - 1;
+    }
+    node.firstChild = (uint32_t) first;
+    node.childCount = count;
+    node.state.store(NODE_EXPANDED, std::memory_order_release);
+}
+
+/*
+ * One simulation: selection by UCT, expansion, a playout and the update of
+ * every node on the path.
+ */
+void MctsSearch::simulate(uint64_t &random) {
+    MctsNode *pool = nodes();
+    uint32_t path[MAX_PLY + 1];
+    int length = 0;
+    uint64_t P = (rootSide == BLACK) ? rootBlack : rootWhite;
+    uint64_t O = (rootSide == BLACK) ? rootWhite : rootBlack;
+
+    uint32_t current = 0;
+    pool[0].visits.fetch_add(1, std::memory_order_relaxed);
+    path[length++] = 0;
+    while (true) {
+        MctsNode &node = pool[current];
+        uint8_t state = node.state.load(std::memory_order_acquire);
+        if (state != NODE_EXPANDED) {
+            uint8_t leaf = NODE_LEAF;
+            if (state == NODE_LEAF && node.visits.load(std::memory_order_relaxed) >= EXPAND_VISITS
+                    && top.load(std::memory_order_relaxed) < halfCapacity
+                    && node.state.compare_exchange_strong(leaf, NODE_EXPANDING)) {
+                expand(node, P, O);
+                if (node.state.load(std::memory_order_relaxed) == NODE_EXPANDED)
+                    continue;
+            }
+            break;
+        }
+        if (node.childCount == 0)
+            break;  // the game is over here
+
+        // UCT; unvisited children first. The visit counted on the way down
+        // is the virtual loss.
+        double logVisits = std::log((double) node.visits.load(std::memory_order_relaxed) + 1);
+        uint32_t best = node.firstChild;
+        double bestValue = -1;
+        for (int c = 0; c < node.childCount; c++) {
+            const MctsNode &child = pool[node.firstChild + c];
+            int visits = child.visits.load(std::memory_order_relaxed);
+            if (visits == 0) {
+                best = node.firstChild + c;
+                break;
+            }
+            double value = child.wins.load(std::memory_order_relaxed) / (2.0 * visits)
+                + UCT_EXPLORATION * std::sqrt(logVisits / visits);
+            if (value > bestValue) {
+                bestValue = value;
+                best = node.firstChild + c;
+            }
+        }
+        pool[best].visits.fetch_add(1, std::memory_order_relaxed);
+        playMove(P, O, pool[best].move);
+        current = best;
+        if (length <= MAX_PLY)
+            path[length++] = best;
+    }
+
+    // the result for the side to move at the leaf; each node keeps it for
+    // the side that moved into it
+    int reward = 2 - playout(P, O, random);
+    for (int i = length - 1; i >= 0; i--) {
+        pool[path[i]].wins.fetch_add(reward, std::memory_order_relaxed);
+        reward = 2 - reward;
+    }
+}
+
+/*
+ * Search thread: simulates until stopped. Thread 0 watches the clock.
+ */
+void MctsSearch::worker(int index, bool timed, SearchClock::time_point deadline) {
+    uint64_t random = 0x9E3779B97F4A7C15ULL * (index + 1)
+        ^ (uint64_t) SearchClock::now().time_since_epoch().count();
+    if (random == 0)
+        random = 1;
+    while (!stop.load(std::memory_order_relaxed)) {
+        for (int i = 0; i < PLAYOUT_BATCH; i++)
+            simulate(random);
+        long long total = playouts.fetch_add(PLAYOUT_BATCH) + PLAYOUT_BATCH;
+        if (total >= maxPlayouts || (index == 0 && timed && SearchClock::now() >= deadline))
+            stop = true;
+    }
+}
+
+/*
+ * Searches the position with all threads and returns the move played most
+ * often from the root. A timed search uses the share of time allocateTime()
+ * gives the move, i.e. about half of the hard limit.
+ */
+int MctsSearch::search(Board &position, Side side, const SearchLimits &limits, long long maxPlayouts) {
+    uint64_t black = position.getMask(BLACK);
+    uint64_t white = position.getMask(WHITE);
+    if (!reuseTree(black, white, side))
+        resetTree(black, white, side);
+    playouts = 0;
+
+    uint64_t mine = (side == BLACK) ? black : white;
+    uint64_t theirs = (side == BLACK) ? white : black;
+    MctsNode &root = nodes()[0];
+    if (root.state != NODE_EXPANDED) {
+        // a kept tree may have left too little room to expand the root
+        if (top + MAX_MOVES > halfCapacity)
+            resetTree(black, white, side);
+        root.state = NODE_EXPANDING;
+        expand(root, mine, theirs);
+    }
+    if (root.state != NODE_EXPANDED || getMoves(mine, theirs) == 0)
+        return PASS;
+
+    SearchClock::time_point start = SearchClock::now();
+    SearchClock::time_point deadline = start + (limits.hardStop - start) / 2;
+    this->maxPlayouts = limits.timed ? LLONG_MAX : maxPlayouts;
+    stop = false;
+    std::vector<std::thread> helpers;
+    for (int i = 1; i < threads; i++)
+        helpers.push_back(std::thread(&MctsSearch::worker, this, i, limits.timed, deadline));
+    worker(0, limits.timed, deadline);
+    for (std::thread &helper : helpers)
+        helper.join();
+
+    int bestMove = PASS;
+    int bestVisits = -1;
+    for (int c = 0; c < root.childCount; c++) {
+        const MctsNode &child = nodes()[root.firstChild + c];
+        if (child.visits > bestVisits) {
+            bestVisits = child.visits;
+            bestMove = child.move;
+        }
+    }
+    return bestMove;
+}
+
+double MctsSearch::getWinRate() {
+    const MctsNode &root = nodes()[0];
+    int visits = root.visits;
+    return visits > 0 ? 1.0 - root.wins / (2.0 * visits) : 0.5;
+}
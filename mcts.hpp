@@ -0,0 +1,86 @@
+#ifndef __MCTS_H__
+#define __MCTS_H__
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include "common.hpp"
+#include "board.hpp"
+#include "search.hpp"
+
+/*
+ * One node of the Monte Carlo tree: the position after move, with the
+ * results of the playouts through it. The children of a node are one
+ * contiguous block of the pool, so a node only needs the index of the first.
+ */
+struct MctsNode {
+    std::atomic<int32_t> visits;    // playouts through the node, virtual losses included
+    std::atomic<int32_t> wins;      // their results in half-points (2 win, 1 draw), for the side that played move
+    uint32_t firstChild;            // valid once state is EXPANDED
+    int8_t move;                    // move id, or PASS
+    uint8_t childCount;
+    std::atomic<uint8_t> state;
+    uint8_t reserved;
+};
+
+/*
+ * Monte Carlo tree search with UCT selection.
+ *
+ * Every simulation walks down the tree by UCT, expands the leaf once it has
+ * been visited EXPAND_VISITS times, plays the game out with light-policy
+ * bitboard moves (a corner when there is one, else a random move) and
+ * counts the result back up the path. Threads search the same tree without
+ * locks: a visit is counted on the way down, before its result is known,
+ * which acts as a virtual loss that steers the other threads elsewhere, and
+ * a leaf is expanded by whichever thread claims it first.
+ *
+ * Nodes come from a pool mapped once, in two halves. The tree grows in one
+ * half with an atomic bump allocator, so the search never allocates. When
+ * the next search's position is in the tree (at most two plies below the
+ * old root, i.e. after our move and the reply), that subtree is copied into
+ * the other half and kept; the rest of the old tree is dropped.
+ */
+class MctsSearch {
+
+private:
+    MctsNode *halves[2];
+    size_t halfCapacity;            // nodes in each half
+    size_t mappingSize;
+    int active;                     // half the tree lives in
+    std::atomic<size_t> top;        // next free node of the active half
+
+    // position of the root node (index 0 of the active half)
+    bool hasTree;
+    uint64_t rootBlack;
+    uint64_t rootWhite;
+    Side rootSide;
+
+    int threads;
+    std::atomic<bool> stop;
+    std::atomic<long long> playouts;
+    long long maxPlayouts;
+
+    MctsNode *nodes() { return halves[active]; }
+    void resetTree(uint64_t black, uint64_t white, Side side);
+    bool reuseTree(uint64_t black, uint64_t white, Side side);
+    void expand(MctsNode &node, uint64_t mine, uint64_t theirs);
+    void simulate(uint64_t &random);
+    void worker(int index, bool timed, SearchClock::time_point deadline);
+
+public:
+    MctsSearch(int threads, size_t megabytes);
+    ~MctsSearch();
+    MctsSearch(const MctsSearch &) = delete;
+    MctsSearch &operator=(const MctsSearch &) = delete;
+
+    // runs until limits' share of time is used (or, untimed, maxPlayouts
+    // playouts) and returns the most visited move, or PASS
+    int search(Board &position, Side side, const SearchLimits &limits, long long maxPlayouts);
+
+    long long getPlayouts() { return playouts; }
+    size_t getTreeSize() { return top < halfCapacity ? top.load() : halfCapacity; }
+    // share of the root's playouts won by the side to move, in [0, 1]
+    double getWinRate();
+};
+
+#endif
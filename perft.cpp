@@ -0,0 +1,204 @@
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include "board.hpp"
+using namespace std;
+
+/*
+ * Move-generator benchmark and check.
+ *
+ * Counts the leaves of the game tree to a fixed depth with the board's own
+ * move generation and make/unmake, from the start position or any position
+ * given in setBoard() form. A pass is a ply of its own; a finished game is a
+ * leaf wherever it ends. From the start position the counts are
+ * 4, 12, 56, 244, 1396, 8200, 55092, 390216, 3005288, 24571284 for depths
+ * 1 to 10. With -v the count below each root move is printed ("divide"),
+ * which narrows a wrong total down to the line that causes it.
+ */
+
+typedef chrono::steady_clock PerftClock;
+
+struct PerftOptions {
+    int depth;
+    int threads;
+    bool divide;
+    char data[64];
+    Side toMove;
+};
+
+/*
+ * One piece of the tree for a worker: the subtree below the root move root
+ * and, when the root is split one ply further, below its reply reply.
+ */
+struct PerftTask {
+    int root;
+    int reply;
+    bool split;
+};
+
+static atomic<int> nextTask;
+
+/*
+ * Leaves of the tree below the position, depth plies deep, with side to move.
+ */
+static long long perft(Board &board, Side side, int depth) {
+    if (depth == 0)
+        return 1;
+    Side other = (side == BLACK) ? WHITE : BLACK;
+    uint64_t moves = board.getLegalMoveMask(side);
+    // each move (or the single pass or game end) is one leaf
+    if (depth == 1)
+        return moves ? popCount(moves) : 1;
+
+    if (moves == 0) {
+        if (board.getLegalMoveMask(other) == 0)
+            return 1;
+        board.makeMove(PASS, side);
+        long long nodes = perft(board, other, depth - 1);
+        board.undoMove();
+        return nodes;
+    }
+
+    long long nodes = 0;
+    for (uint64_t b = moves; b; b &= b - 1) {
+        board.makeMove(firstSquare(b), side);
+        nodes += perft(board, other, depth - 1);
+        board.undoMove();
+    }
+    return nodes;
+}
+
+/*
+ * The moves of side in the position, with a lone PASS when side has to pass.
+ * Empty once the game is over.
+ */
+static void rootMoves(Board &board, Side side, MoveList &list) {
+    Side other = (side == BLACK) ? WHITE : BLACK;
+    list.size = 0;
+    for (uint64_t b = board.getLegalMoveMask(side); b; b &= b - 1)
+        list.moves[list.size++] = firstSquare(b);
+    if (list.size == 0 && board.hasMoves(other))
+        list.moves[list.size++] = PASS;
+}
+
+/*
+ * Worker thread: takes tasks until none are left and adds their leaves to
+ * the count of their root move.
+ */
+static void worker(const PerftOptions &options, const vector<PerftTask> &tasks,
+                   const MoveList &roots, atomic<long long> counts[]) {
+    Side other = (options.toMove == BLACK) ? WHITE : BLACK;
+    Board board;
+    board.setBoard((char *) options.data);
+    for (int t = nextTask++; t < (int) tasks.size(); t = nextTask++) {
+        const PerftTask &task = tasks[t];
+        board.makeMove(roots.moves[task.root], options.toMove);
+        long long nodes;
+        if (task.split) {
+            board.makeMove(task.reply, other);
+            nodes = perft(board, options.toMove, options.depth - 2);
+            board.undoMove();
+        }
+        else
+            nodes = perft(board, other, options.depth - 1);
+        board.undoMove();
+        counts[task.root] += nodes;
+    }
+}
+
+static void usage(const char *name) {
+    cerr << "usage: " << name << " [-d depth] [-j threads] [-v] [-p position [-w]]" << endl
+         << "  -d  plies to count (default 9)" << endl
+         << "  -j  threads, splitting the tree at the root (default 1)" << endl
+         << "  -v  print the count below each root move" << endl
+         << "  -p  64 squares a1 .. h8, row by row: 'b' black, 'w' white, anything else empty" << endl
+         << "  -w  white to move (default black)" << endl;
+    exit(-1);
+}
+
+int main(int argc, char *argv[]) {
+    PerftOptions options;
+    options.depth = 9;
+    options.threads = 1;
+    options.divide = false;
+    options.toMove = BLACK;
+    Board start;
+    for (int sq = 0; sq < 64; sq++)
+        options.data[sq] = ((start.getMask(BLACK) >> sq) & 1) ? 'b' : ((start.getMask(WHITE) >> sq) & 1) ? 'w' : ' ';
+
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (!strcmp(argv[i], "-d") && hasValue)
+            options.depth = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-j") && hasValue)
+            options.threads = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-v"))
+            options.divide = true;
+        else if (!strcmp(argv[i], "-p") && hasValue) {
+            if (strlen(argv[++i]) != 64)
+                usage(argv[0]);
+            memcpy(options.data, argv[i], 64);
+        }
+        else if (!strcmp(argv[i], "-w"))
+            options.toMove = WHITE;
+        else
+            usage(argv[0]);
+    }
+    if (options.depth < 1 || options.depth > MAX_PLY)
+        usage(argv[0]);
+    if (options.threads < 1)
+        options.threads = 1;
+
+    Board board;
+    board.setBoard(options.data);
+    Side other = (options.toMove == BLACK) ? WHITE : BLACK;
+    MoveList roots;
+    rootMoves(board, options.toMove, roots);
+
+    // with fewer root moves than threads, hand out the replies one by one instead
+    vector<PerftTask> tasks;
+    bool split = roots.size < options.threads && options.depth >= 3;
+    for (int r = 0; r < roots.size; r++) {
+        if (!split) {
+            tasks.push_back({ r, PASS, false });
+            continue;
+        }
+        board.makeMove(roots.moves[r], options.toMove);
+        MoveList replies;
+        rootMoves(board, other, replies);
+        board.undoMove();
+        if (replies.size == 0)
+            tasks.push_back({ r, PASS, false });
+        for (int m = 0; m < replies.size; m++)
+            tasks.push_back({ r, replies.moves[m], true });
+    }
+
+    vector<atomic<long long>> counts(roots.size > 0 ? roots.size : 1);
+    for (atomic<long long> &count : counts)
+        count = 0;
+
+    PerftClock::time_point begin = PerftClock::now();
+    vector<thread> workers;
+    for (int i = 0; i < options.threads && i < (int) tasks.size(); i++)
+        workers.push_back(thread(worker, cref(options), cref(tasks), cref(roots), counts.data()));
+    for (thread &t : workers)
+        t.join();
+    double seconds = chrono::duration<double>(PerftClock::now() - begin).count();
+
+    // a finished game is a single leaf
+    long long nodes = (roots.size == 0) ? 1 : 0;
+    for (int r = 0; r < roots.size; r++) {
+        if (options.divide)
+            printf("%s %lld\n", squareName(roots.moves[r]).c_str(), counts[r].load());
+        nodes += counts[r];
+    }
+    printf("perft %d: %lld nodes, %.3f s, %.1f Mnps on %d threads\n", options.depth, nodes, seconds,
+           seconds > 0 ? nodes / seconds / 1e6 : 0.0, (int) workers.size() > 0 ? (int) workers.size() : 1);
+    return 0;
+}
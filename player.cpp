@@ -1,13 +1,79 @@
 #include "player.hpp"
+#include <cstdlib>
+
+/*
+ * The default engine settings, with the thread count taken from the
+ * OTHELLO_THREADS environment variable and pondering switched by
+ * OTHELLO_PONDER, if they are set.
+ */
+static PlayerConfig defaultConfig() {
+    PlayerConfig config;
+    const char *threads = getenv("OTHELLO_THREADS");
+    if (threads != nullptr && atoi(threads) > 0)
+        config.threads = atoi(threads);
+    const char *ponder = getenv("OTHELLO_PONDER");
+    if (ponder != nullptr)
+        config.ponder = atoi(ponder) != 0;
+    return config;
+}
 
 /*
  * Constructor for the player; initialize everything here. The side your AI is
  * on (BLACK or WHITE) is passed in as "side". The constructor must finish
  * within 30 seconds.
  */
-Player::Player(Side side) {
+Player::Player(Side side) : Player(side, defaultConfig()) {
+}
+
+/*
+ * The tables a standalone player works with, made and loaded as the config
+ * says.
+ */
+static SharedTables makeTables(const PlayerConfig &config) {
+    SharedTables tables;
+    tables.tt = new TranspositionTable(config.ttSizeMb);
+
+    // the book is only mapped here, so this costs next to nothing
+    tables.book = new OpeningBook();
+    if (!config.bookPath.empty() && tables.book->open(config.bookPath.c_str()) && config.verbose)
+        cerr << "Opening book: " << tables.book->size() << " positions" << endl;
+
+    if (config.patternEval)
+    {
+        PatternEval *eval = new PatternEval();
+        if (!config.evalPath.empty() && eval->load(config.evalPath.c_str()) && config.verbose)
+            cerr << "Pattern weights: " << config.evalPath << endl;
+        tables.eval = eval;
+    }
+
+    ProbCut *probCut = new ProbCut();
+    if (!config.probCutPath.empty() && probCut->load(config.probCutPath.c_str()))
+    {
+        if (config.verbose)
+            cerr << "Multi-ProbCut parameters: " << config.probCutPath << endl;
+        tables.probCut = probCut;
+    }
+    else
+        delete probCut;
+    return tables;
+}
+
+/*
+ * Constructor for the player with explicit engine settings.
+ */
+Player::Player(Side side, const PlayerConfig &config) : Player(side, config, makeTables(config)) {
+    ownsTables = true;
+}
+
+/*
+ * Constructor for a player working with tables made by the caller.
+ */
+Player::Player(Side side, const PlayerConfig &config, const SharedTables &tables)
+    : config(config), tables(tables), ownsTables(false), searchPool(config.threads, tables.tt), mcts(nullptr) {
     // Will be set to true in test_minimax.cpp.
     testingMinimax = false;
+    ponderStop = false;
+    hasExpectation = false;
 
     /*
      * TODO: Do any initialization you need to do here (setting up the board,
@@ -19,7 +85,14 @@ Player::Player(Side side) {
     clock_t beginTime = clock();  // snapshot the clock for starting
     mySide = side;
     otherSide = (mySide == BLACK) ? WHITE : BLACK;
-    cerr << "Side = " << (side==BLACK? "BLACK" : "WHITE") << endl;
+    if (config.verbose)
+        cerr << "Side = " << (side==BLACK? "BLACK" : "WHITE") << endl;
+
+    searchPool.setEvaluation(tables.eval);
+    searchPool.setProbCut(tables.probCut, config.probCutConfidence);
+    if (config.mode == MCTS_SEARCH)
+        mcts = new MctsSearch(config.threads, config.mctsMemoryMb);
+    TELEMETRY(counters.open());
 
     double elapsed_msec = double(clock() - beginTime)/CLOCKS_PER_SEC * 1000;
 
@@ -31,6 +104,15 @@ Player::Player(Side side) {
  * Destructor for the player.
  */
 Player::~Player() {
+    stopPondering();
+    delete mcts;
+    if (ownsTables)
+    {
+        delete tables.tt;
+        delete tables.book;
+        delete tables.eval;
+        delete tables.probCut;
+    }
 }
 
 /*
@@ -47,52 +129,260 @@ Player::~Player() {
  * return nullptr.
  */
 Move *Player::doMove(Move *opponentsMove, int msLeft) {
+    return play(PackedMove::of(opponentsMove), msLeft).toMove();
+}
+
+/*
+ * doMove() by value: takes the opponent's move (PASS for none) and returns
+ * ours (PASS if we have no legal move), without allocating.
+ */
+PackedMove Player::play(PackedMove opponentsMove, int msLeft) {
     /*
      * TODO: Implement how moves your AI should play here. You should first
      * process the opponent's opponents move before calculating your own move
      */
-    clock_t beginTime= clock(); // snapshot the clock for starting
+    // wall-clock snapshot: msLeft is measured in real time by the game
+    SearchClock::time_point beginTime = SearchClock::now();
+
+    // whatever the ponder search found is in the transposition table now
+    stopPondering();
 
-    // first we check whether the opponentsMove is not nullptr and then we need to check if it is legal
-    if (opponentsMove != nullptr && !playBoard.checkMove(opponentsMove, otherSide))
+    TELEMETRY(telemetry = MoveTelemetry());
+    TELEMETRY(counters.start());
+
+    // first we check whether the opponentsMove is not a pass and then we need to check if it is legal
+    if (!opponentsMove.isPass() && !playBoard.checkMove(opponentsMove, otherSide))
         cerr << "Side " << (otherSide==WHITE ? "WHITE": "BLACK") << " are making an illegal move" << endl;
 
     // Modifies the board to reflect the specified move.
     playBoard.doMove(opponentsMove, otherSide);
 
+    // did the opponent play the reply our last search expected?
+    bool replyExpected = hasExpectation && opponentsMove.id == expectedReply;
+    hasExpectation = false;
 
-    // // now we check every legal move
-    // vector<int> legalMoveIdVec = playBoard.getLegalMoveIds(mySide);
-    // if (legalMoveIdVec.size() == 0) // no legal move
-    //     return nullptr;
-    // // for (int id : legalMoveIdVec)
-    // // {
-    // //     cerr << "(x,y)=(" << id%8 << "," << id/8 << ")" << endl;
-    // // }
-
-    // // now we check some legal move
-    // // int id = legalMoveIdVec[0];
-    // int id = playBoard.getBestMoveId(mySide, legalMoveIdVec);
-
-
-    // Move *myMove = new Move(id%8, id/8);
-
-    // // One-ply decision (greedy)
-    // Move *myMove = playBoard.getBestNextMove(mySide);
 
-    // Two-ply decision tree
-    Move *myMove = playBoard.getMiniMaxMove(mySide);
+    PackedMove myMove;
+    if (testingMinimax)
+    {
+        // test_minimax checks the 2-ply decision tree specifically
+        myMove = playBoard.miniMaxMove(mySide);
+    }
+    else
+    {
+        switch (config.mode)
+        {
+        case GREEDY_SEARCH:
+            // One-ply decision (greedy)
+            myMove = playBoard.bestNextMove(mySide);
+            TELEMETRY(telemetry.source = "greedy");
+            break;
+        case MINIMAX_2PLY:
+            // Two-ply decision tree
+            myMove = playBoard.miniMaxMove(mySide);
+            TELEMETRY(telemetry.source = "minimax2");
+            break;
+        case MINIMAX_NPLY:
+            // N-ply decision tree
+            myMove = playBoard.miniMaxMove(mySide, config.depth);
+            TELEMETRY(telemetry.source = "minimax");
+            break;
+        case ALPHABETA_SEARCH:
+            // Iterative deepening negamax with alpha-beta pruning
+            myMove = getIterativeMove(beginTime, msLeft, replyExpected);
+            break;
+        case MCTS_SEARCH:
+            // Monte Carlo tree search, keeping the tree between moves
+            myMove = getMctsMove(beginTime, msLeft);
+            break;
+        }
+    }
 
-    // // N-ply decision tree
-    // int lookAheadLevel = 1;
-    // Move *myMove = playBoard.getMiniMaxMove(mySide, lookAheadLevel);
-
-    double elapsed_msec = double(clock() - beginTime)/CLOCKS_PER_SEC * 1000;
+    double elapsed_msec = std::chrono::duration<double, std::milli>(SearchClock::now() - beginTime).count();
     if (msLeft > -1 && msLeft < elapsed_msec)
         cerr << "No time left" << endl;
 
+    TELEMETRY(telemetry.hasCounters = counters.stop(telemetry.cycles, telemetry.instructions, telemetry.cacheMisses));
+    TELEMETRY(telemetry.side = mySide);
+    TELEMETRY(telemetry.empties = 64 - playBoard.countBlack() - playBoard.countWhite());
+    TELEMETRY(telemetry.move = myMove.id);
+    TELEMETRY(telemetry.ms = elapsed_msec);
+    TELEMETRY(emitTelemetry(telemetry));
+
     // Before return myMove, update playBoard
     playBoard.doMove(myMove, mySide);
 
+    if (config.ponder && config.mode == ALPHABETA_SEARCH && !testingMinimax)
+        startPondering();
+
     return myMove;
 }
+
+/*
+ * Starts searching the position the opponent now has to move in, on the
+ * opponent's time. The search is untimed and runs until stopPondering() or
+ * until it has seen to the end of the game; everything it finds goes into
+ * the transposition table, where the next search picks it up. Searching
+ * the opponent's position covers all of their replies, but most of the
+ * effort goes into the one the search expects them to play.
+ */
+void Player::startPondering() {
+    if (playBoard.isDone())
+        return;
+    int bookId;
+    int bookScore;
+    if (tables.book != nullptr && tables.book->probe(playBoard, otherSide, bookId, bookScore))
+        return;  // our reply will come from the book as well
+
+    ponderStop = false;
+    searchPool.setAbortFlag(&ponderStop);
+    Board position = playBoard;
+    ponderThread = std::thread([this, position]() mutable {
+        SearchLimits limits;
+        int replyId;
+        searchPool.search(position, otherSide, limits, replyId);
+    });
+}
+
+/*
+ * Stops the ponder search, if one is running, and waits for its threads.
+ */
+void Player::stopPondering() {
+    if (!ponderThread.joinable())
+        return;
+    ponderStop = true;
+    ponderThread.join();
+    searchPool.setAbortFlag(nullptr);
+    if (config.verbose)
+        cerr << "Ponder: depth " << searchPool.getDepthReached() << ", nodes " << searchPool.getNodes() << endl;
+}
+
+/*
+ * Reads the line the search just settled on out of the transposition table
+ * and keeps the opponent's expected reply and our answer to it, so that the
+ * next search can pick up where this one left off.
+ */
+void Player::rememberLine(int score, int depth) {
+    int line[8];
+    int length = probeLine(*tables.tt, playBoard, mySide, line, 8);
+    if (length >= 3)
+    {
+        hasExpectation = true;
+        expectedReply = line[1];
+        expectedMove = line[2];
+        expectedScore = score;
+        expectedDepth = depth;
+    }
+
+    if (!config.verbose)
+        return;
+    cerr << "  line";
+    for (int i = 0; i < length; i++)
+        cerr << " " << squareName(line[i]);
+    cerr << endl;
+}
+
+/*
+ * Plays the book move if the position is in the opening book. Otherwise
+ * searches deeper and deeper with alpha-beta (on config.threads threads) until
+ * the share of msLeft given to this move runs out, and plays the move of the
+ * last completed depth. From config.endgameEmpties empty squares on, the
+ * position is solved exactly instead, falling back to a short search's move
+ * if the solve does not finish in time.
+ * Untimed games (msLeft == -1) stop at config.depth instead.
+ *
+ * The transposition table, the move-ordering tables and the expected line
+ * carry over from move to move. When the opponent played the reply the last
+ * search expected, that search already covered this position two plies
+ * shallower: the search resumes from there, expected move first, with an
+ * aspiration window around the expected score.
+ */
+PackedMove Player::getIterativeMove(SearchClock::time_point beginTime, int msLeft, bool replyExpected) {
+    int bookId;
+    int bookScore;
+    if (tables.book != nullptr && tables.book->probe(playBoard, mySide, bookId, bookScore))
+    {
+        if (config.verbose)
+            cerr << "Book: score " << bookScore << endl;
+        TELEMETRY(telemetry.source = "book");
+        TELEMETRY(telemetry.score = bookScore);
+        return PackedMove(bookId);
+    }
+
+    int empties = 64 - playBoard.countBlack() - playBoard.countWhite();
+    SearchLimits limits = allocateTime(beginTime, msLeft, empties);
+    if (!limits.timed)
+        limits.maxDepth = config.depth;
+
+    if (ownsTables)
+        tables.tt->newSearch();
+    searchPool.setMoveOrdering(config.moveOrdering);
+    if (replyExpected)
+        searchPool.setGuess(expectedMove, expectedScore, expectedDepth - 2);
+    int bestId;
+    if (empties > config.endgameEmpties)
+    {
+        int score = searchPool.search(playBoard, mySide, limits, bestId);
+        if (config.verbose)
+            cerr << "Search: depth " << searchPool.getDepthReached() << ", score " << score
+                << ", nodes " << searchPool.getNodes() << ", threads " << searchPool.getThreads()
+                << (replyExpected ? ", expected reply" : "") << endl;
+        rememberLine(score, searchPool.getDepthReached());
+        TELEMETRY(telemetry.nodes = searchPool.getNodes());
+        TELEMETRY(telemetry.depth = searchPool.getDepthReached());
+        TELEMETRY(telemetry.score = score);
+        TELEMETRY(telemetry.threads = searchPool.getThreads());
+        TELEMETRY(telemetry.stats = searchPool.getStats());
+    }
+    else
+    {
+        // a quick midgame search first, to have a move if the solve runs out of time
+        SearchLimits quick = limits;
+        if (quick.timed)
+        {
+            quick.softStop = beginTime + (limits.softStop - beginTime) / 4;
+            quick.hardStop = beginTime + (limits.hardStop - beginTime) / 4;
+        }
+        searchPool.search(playBoard, mySide, quick, bestId);
+        TELEMETRY(telemetry.stats = searchPool.getStats());
+        TELEMETRY(telemetry.threads = searchPool.getThreads());
+
+        EndgameSolver solver(tables.tt);
+        if (limits.timed)
+            solver.setDeadline(limits.hardStop);
+        int solvedId;
+        int score = solver.solveRoot(playBoard, mySide, solvedId);
+        if (!solver.wasStopped())
+            bestId = solvedId;
+        TELEMETRY(telemetry.source = "endgame");
+        TELEMETRY(telemetry.nodes = searchPool.getNodes() + solver.getNodes());
+        TELEMETRY(telemetry.depth = solver.wasStopped() ? searchPool.getDepthReached() : empties);
+        TELEMETRY(telemetry.score = solver.wasStopped() ? 0 : score);
+        if (config.verbose)
+        {
+            cerr << "Endgame: empties " << empties << ", nodes " << solver.getNodes();
+            if (solver.wasStopped())
+                cerr << ", out of time (depth " << searchPool.getDepthReached() << " search move played)" << endl;
+            else
+                cerr << ", exact score " << score << endl;
+        }
+    }
+    return PackedMove(bestId);
+}
+
+/*
+ * Picks a move by Monte Carlo tree search in the time allocateTime() gives
+ * the move, or with config.mctsPlayouts playouts when untimed.
+ */
+PackedMove Player::getMctsMove(SearchClock::time_point beginTime, int msLeft) {
+    int empties = 64 - playBoard.countBlack() - playBoard.countWhite();
+    SearchLimits limits = allocateTime(beginTime, msLeft, empties);
+    int bestId = mcts->search(playBoard, mySide, limits, config.mctsPlayouts);
+    if (config.verbose)
+        cerr << "MCTS: playouts " << mcts->getPlayouts() << ", tree " << mcts->getTreeSize()
+            << " nodes, win rate " << mcts->getWinRate() << endl;
+    TELEMETRY(telemetry.source = "mcts");
+    TELEMETRY(telemetry.nodes = mcts->getPlayouts());
+    TELEMETRY(telemetry.threads = config.threads);
+    return PackedMove(bestId);
+}
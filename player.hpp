@@ -4,23 +4,123 @@
 #include <iostream>
 #include "common.hpp"
 #include "board.hpp"
+#include "search.hpp"
+#include "endgame.hpp"
+#include "book.hpp"
+#include "eval.hpp"
+#include "telemetry.hpp"
+#include "mcts.hpp"
+#include <string>
 #include <ctime>
+#include <atomic>
+#include <thread>
 
 using namespace std;
 
+/*
+ * How the player picks its moves.
+ */
+enum SearchMode {
+    GREEDY_SEARCH,      // 1-ply, Board::getBestNextMove()
+    MINIMAX_2PLY,       // Board::getMiniMaxMove(side)
+    MINIMAX_NPLY,       // Board::getMiniMaxMove(side, depth)
+    ALPHABETA_SEARCH,   // iterative-deepening alpha-beta within the move's time share
+    MCTS_SEARCH         // Monte Carlo tree search within the move's time share
+};
+
+/*
+ * Engine settings handed to the Player constructor.
+ */
+struct PlayerConfig {
+    SearchMode mode;
+    int depth;          // lookahead for MINIMAX_NPLY; ALPHABETA_SEARCH depth when untimed
+    int ttSizeMb;       // transposition table size in megabytes
+    bool moveOrdering;  // hash move/killer/history ordering in the alpha-beta search
+    int threads;        // search threads (Lazy SMP, or MCTS); OTHELLO_THREADS overrides the default
+    int endgameEmpties; // solve exactly from this many empty squares on
+    string bookPath;    // opening book to map at start-up; empty for none
+    bool patternEval;   // pattern evaluation at the alpha-beta leaves instead of square weights
+    string evalPath;    // pattern weights to load; the defaults are seeded from the square weights
+    string probCutPath; // Multi-ProbCut parameters for the leaf evaluation in use; empty or missing: full width
+    double probCutConfidence; // cut at this many standard deviations of the shallow search's prediction
+    bool ponder;        // keep searching on the opponent's time; OTHELLO_PONDER=1 turns it on by default
+    bool verbose;       // log the set-up and every move's search to cerr
+    int mctsMemoryMb;   // MCTS node pool in megabytes; only touched as the tree grows
+    long long mctsPlayouts; // MCTS playouts per move when untimed
+
+    PlayerConfig() : mode(ALPHABETA_SEARCH), depth(6), ttSizeMb(64), moveOrdering(true), threads(1),
+        endgameEmpties(20), bookPath("othello.book"), patternEval(true), evalPath("othello.weights"),
+        probCutPath("othello.probcut"), probCutConfidence(PROBCUT_CONFIDENCE), ponder(false), verbose(true),
+        mctsMemoryMb(512), mctsPlayouts(100000) {}
+};
+
+/*
+ * The big tables behind a player. A standalone player makes its own from its
+ * PlayerConfig; a server hosting many games makes one set and hands it to
+ * every player, so that a game costs little more than its board and search
+ * stacks. The book and the weights are only read; the transposition table is
+ * lock-free and keyed by position, so games can share it as threads do. A
+ * player only ages a table it made; the owner of a shared one decides when
+ * a new search generation starts (TranspositionTable::newSearch()).
+ */
+struct SharedTables {
+    TranspositionTable *tt;
+    OpeningBook *book;          // nullptr: no book
+    const PatternEval *eval;    // nullptr: square weights at the leaves
+    const ProbCut *probCut;     // nullptr: full-width alpha-beta
+
+    SharedTables() : tt(nullptr), book(nullptr), eval(nullptr), probCut(nullptr) {}
+};
+
 class Player {
 
 private:
 	Board playBoard;
 	Side mySide;
 	Side otherSide;   // keep this for efficiency
+	PlayerConfig config;
+	SharedTables tables;
+	bool ownsTables;  // made by this player from config, and deleted with it
+	SearchPool searchPool;
+	MctsSearch *mcts;   // only in MCTS_SEARCH mode
+
+	// background search of the opponent's position between our moves
+	std::thread ponderThread;
+	std::atomic<bool> ponderStop;
+
+	// what the last search expects: the opponent's reply, then our move and
+	// the score after it, searched to expectedDepth plies from our last move
+	bool hasExpectation;
+	int expectedReply;
+	int expectedMove;
+	int expectedScore;
+	int expectedDepth;
+
+	// the move being made, for telemetry builds
+	MoveTelemetry telemetry;
+	PerfCounters counters;
+
+	PackedMove getIterativeMove(SearchClock::time_point beginTime, int msLeft, bool replyExpected);
+	PackedMove getMctsMove(SearchClock::time_point beginTime, int msLeft);
+	void rememberLine(int score, int depth);
+	void startPondering();
+	void stopPondering();
 
 public:
     Player(Side side);
+    Player(Side side, const PlayerConfig &config);
+    // uses tables instead of making its own; they must outlive the player
+    Player(Side side, const PlayerConfig &config, const SharedTables &tables);
     ~Player();
 
     void setBoard(char data[]) { playBoard.setBoard(data); }
     Move *doMove(Move *opponentsMove, int msLeft);
+    PackedMove play(PackedMove opponentsMove, int msLeft);
+    // whether the opponent can play the move on our board; a pass is always
+    // accepted, as it also stands for no move yet
+    bool isLegalReply(PackedMove opponentsMove) {
+        return opponentsMove.isPass() || playBoard.checkMove(opponentsMove, otherSide);
+    }
 
     // Flag to tell if the player is running within the test_minimax context
     bool testingMinimax;
@@ -0,0 +1,70 @@
+#include "probcut.hpp"
+#include <cstdio>
+#include <cstring>
+
+/*
+ * File header of a parameters file, followed by the ProbCutFit of every
+ * depth 0 .. depths - 1 of each stage in turn.
+ */
+struct ProbCutHeader {
+    char magic[8];
+    uint32_t stages;
+    uint32_t depths;
+};
+
+static const char PROBCUT_MAGIC[8] = { 'O', 'T', 'H', 'P', 'C', 'U', 'T', '1' };
+
+/*
+ * Make a set of parameters that cuts nothing.
+ */
+ProbCut::ProbCut() {
+    for (int stage = 0; stage < NUM_STAGES; stage++)
+        for (int depth = 0; depth <= PROBCUT_MAX_DEPTH; depth++)
+            fits[stage][depth] = { 1.0f, 0.0f, 0.0f };
+}
+
+/*
+ * Reads a parameters file. The file must have been written for the same
+ * stages and depths; fits with a slope too flat to invert are dropped.
+ */
+bool ProbCut::load(const char *path) {
+    FILE *file = fopen(path, "rb");
+    if (file == nullptr)
+        return false;
+
+    ProbCutHeader header;
+    ProbCutFit read[NUM_STAGES][PROBCUT_MAX_DEPTH + 1];
+    bool ok = fread(&header, sizeof(header), 1, file) == 1
+        && memcmp(header.magic, PROBCUT_MAGIC, sizeof(PROBCUT_MAGIC)) == 0
+        && header.stages == (uint32_t) NUM_STAGES
+        && header.depths == (uint32_t) (PROBCUT_MAX_DEPTH + 1)
+        && fread(read, sizeof(read), 1, file) == 1;
+    fclose(file);
+    if (!ok)
+        return false;
+
+    for (int stage = 0; stage < NUM_STAGES; stage++)
+        for (int depth = 0; depth <= PROBCUT_MAX_DEPTH; depth++) {
+            fits[stage][depth] = read[stage][depth];
+            if (!(read[stage][depth].slope > 0.1f) || depth < PROBCUT_MIN_DEPTH)
+                fits[stage][depth].sigma = 0.0f;
+        }
+    return true;
+}
+
+/*
+ * Writes the parameters with the header load() checks.
+ */
+bool ProbCut::save(const char *path) const {
+    FILE *file = fopen(path, "wb");
+    if (file == nullptr)
+        return false;
+
+    ProbCutHeader header;
+    memcpy(header.magic, PROBCUT_MAGIC, sizeof(PROBCUT_MAGIC));
+    header.stages = NUM_STAGES;
+    header.depths = PROBCUT_MAX_DEPTH + 1;
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1
+        && fwrite(fits, sizeof(fits), 1, file) == 1;
+    return fclose(file) == 0 && ok;
+}
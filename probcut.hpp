@@ -0,0 +1,63 @@
+#ifndef __PROBCUT_H__
+#define __PROBCUT_H__
+
+#include "common.hpp"
+#include "eval.hpp"
+
+// Shallowest and deepest search depths that are cut with Multi-ProbCut;
+// deeper searches use the parameters of PROBCUT_MAX_DEPTH.
+const int PROBCUT_MIN_DEPTH = 3;
+const int PROBCUT_MAX_DEPTH = 24;
+// Cut when the deep result is outside the window with at least this many
+// standard deviations of the prediction to spare, by default.
+const double PROBCUT_CONFIDENCE = 1.5;
+
+/*
+ * How the result of a shallow search predicts that of a deep one in the
+ * same position: deep = slope * shallow + intercept, with an error of
+ * standard deviation sigma. A sigma of zero marks a pair that has not been
+ * calibrated and is never cut.
+ */
+struct ProbCutFit {
+    float slope;
+    float intercept;
+    float sigma;
+};
+
+/*
+ * Multi-ProbCut parameters: one linear fit for every search depth from
+ * PROBCUT_MIN_DEPTH on and every evaluation stage, relating the search of
+ * that depth to one of shallowDepth() plies. They are fitted offline by the
+ * calibrator from self-play positions, for one evaluation, and only hold
+ * for the evaluation they were fitted with.
+ */
+class ProbCut {
+
+private:
+    ProbCutFit fits[NUM_STAGES][PROBCUT_MAX_DEPTH + 1];
+
+public:
+    ProbCut();
+
+    // replaces the parameters with the ones in the file; false (parameters unchanged) if it cannot be read
+    bool load(const char *path);
+    // writes the parameters in the format load() reads; false if the file cannot be written
+    bool save(const char *path) const;
+
+    // the depth of the search that predicts one of the given depth: about
+    // half as deep, with the same parity so that both end on the same side
+    static int shallowDepth(int depth) {
+        return ((depth / 2) & ~1) | (depth & 1);
+    }
+
+    // the fit for a search of depth plies with discs discs on the board, or nullptr if there is none
+    const ProbCutFit *fit(int discs, int depth) const {
+        if (depth < PROBCUT_MIN_DEPTH)
+            return nullptr;
+        const ProbCutFit &f = fits[PatternEval::stageOf(discs)][depth < PROBCUT_MAX_DEPTH ? depth : PROBCUT_MAX_DEPTH];
+        return f.sigma > 0 ? &f : nullptr;
+    }
+    ProbCutFit &at(int stage, int depth) { return fits[stage][depth]; }
+};
+
+#endif
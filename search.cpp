@@ -0,0 +1,867 @@
+#include "search.hpp"
+#include "batch.hpp"
+#include <cmath>
+#include <thread>
+
+// Nodes between two looks at the clock.
+static const long long TIME_CHECK_INTERVAL = 1024;
+// Time kept back from every move for process and pipe overhead, in ms.
+static const int TIME_SAFETY_MS = 30;
+
+// Move-ordering tiers, from first to last tried.
+static const int ORDER_HASH = 1 << 30;
+static const int ORDER_CORNER = 1 << 29;
+static const int ORDER_KILLER1 = 1 << 28;
+static const int ORDER_KILLER2 = 1 << 27;
+// Fewest opponent replies first is worth (63 - replies) << ORDER_MOBILITY_SHIFT.
+static const int ORDER_MOBILITY_SHIFT = 21;
+// Remaining depth from which moves are also ordered by opponent mobility.
+static const int MOBILITY_ORDER_DEPTH = 4;
+// History scores are halved once one of them reaches this.
+static const int HISTORY_MAX = 1 << 17;
+
+// Half-width of the first aspiration window around the expected score; it
+// grows ASPIRATION_GROWTH times on every failure, and is dropped for the full
+// window once wider than ASPIRATION_MAX.
+static const int ASPIRATION_WINDOW = 40;
+static const int ASPIRATION_GROWTH = 4;
+static const int ASPIRATION_MAX = 1000;
+// First iteration searched with an aspiration window.
+static const int ASPIRATION_DEPTH = 4;
+
+/*
+ * Static move priority of each square, used to break ties between moves with
+ * no other information: corners, then edges and the centre, X-squares last.
+ */
+static const int SQUARE_PRIORITY[64] = {
+    15,  2, 12, 10, 10, 12,  2, 15,
+     2,  0,  5,  5,  5,  5,  0,  2,
+    12,  5,  8,  7,  7,  8,  5, 12,
+    10,  5,  7,  0,  0,  7,  5, 10,
+    10,  5,  7,  0,  0,  7,  5, 10,
+    12,  5,  8,  7,  7,  8,  5, 12,
+     2,  0,  5,  5,  5,  5,  0,  2,
+    15,  2, 12, 10, 10, 12,  2, 15
+};
+
+static const uint64_t CORNERS = 0x8100000000000081ULL;
+
+/*
+ * Make a search over a private copy of the given position.
+ */
+Search::Search(Board &position, TranspositionTable *table) : board(position) {
+    tt = table;
+    nodes = 0;
+    nextCheck = 0;
+    frontierBatches = 0;
+    eval = nullptr;
+    patternTop = 0;
+    probCut = nullptr;
+    probCutConfidence = PROBCUT_CONFIDENCE;
+    ordering = true;
+    for (int ply = 0; ply < MAX_PLY; ++ply)
+        killers[ply][0] = killers[ply][1] = PASS;
+    for (int side = 0; side < 2; ++side)
+        for (int sq = 0; sq < 64; ++sq)
+            history[side][sq] = 0;
+    timed = false;
+    nodeLimit = 0;
+    stopped = false;
+    depthReached = 0;
+    abortFlag = nullptr;
+    hasGuess = false;
+    guessMove = PASS;
+    guessScore = 0;
+}
+
+/*
+ * Destructor for the search.
+ */
+Search::~Search() {
+}
+
+/*
+ * Replaces the position to search. Killers and history carry over.
+ */
+void Search::setPosition(Board &position) {
+    board = position;
+    patternTop = 0;
+    if (eval != nullptr)
+        PatternEval::initState(board, patterns[0]);
+}
+
+void Search::setGuess(int moveId, int score) {
+    hasGuess = true;
+    guessMove = moveId;
+    guessScore = score;
+}
+
+void Search::setEvaluation(const PatternEval *weights) {
+    eval = weights;
+    setPosition(board);
+}
+
+void Search::setProbCut(const ProbCut *cuts, double confidence) {
+    probCut = cuts;
+    probCutConfidence = confidence;
+}
+
+/*
+ * Makes a move on the search board, keeping the pattern indices in step.
+ */
+template <Side side>
+void Search::playMove(int moveId) {
+    uint64_t flips = board.makeMove<side>(moveId);
+    if (eval != nullptr)
+    {
+        patterns[patternTop + 1] = patterns[patternTop];
+        PatternEval::update(patterns[patternTop + 1], moveId, flips, side);
+        ++patternTop;
+    }
+}
+
+template <Side side>
+void Search::takeBack() {
+    board.undoMove<side>();
+    if (eval != nullptr)
+        --patternTop;
+}
+
+/*
+ * Exact score of a finished game for the side owning mine: the disc margin
+ * (with the empty squares going to the winner) pushed beyond any heuristic
+ * score.
+ */
+static int finalScore(uint64_t mine, uint64_t theirs)
+{
+    int mineCount = popCount(mine);
+    int theirsCount = popCount(theirs);
+    int empties = 64 - mineCount - theirsCount;
+    if (mineCount > theirsCount)
+        return SCORE_WIN + mineCount - theirsCount + empties;
+    if (mineCount < theirsCount)
+        return -SCORE_WIN + mineCount - theirsCount - empties;
+    return 0;
+}
+
+/*
+ * Static score of the current position for the side to move, or its exact
+ * score if neither side can move (a full board included).
+ */
+template <Side side>
+int Search::evaluate() {
+    uint64_t mine = board.getMask<side>();
+    uint64_t theirs = board.getMask<opponentOf(side)>();
+    uint64_t myMoves = getMoves(mine, theirs);
+    if (eval == nullptr)
+    {
+        if (myMoves == 0 && getMoves(theirs, mine) == 0)
+            return finalScore(mine, theirs);
+        return board.calcPositionalScore(side);
+    }
+    uint64_t theirMoves = getMoves(theirs, mine);
+    if ((myMoves | theirMoves) == 0)
+        return finalScore(mine, theirs);
+    return eval->evaluate(patterns[patternTop], mine, theirs, side, popCount(myMoves) - popCount(theirMoves));
+}
+
+/*
+ * Returns true once the hard deadline has passed or another thread asked
+ * this search to stop. Both are only looked at every TIME_CHECK_INTERVAL
+ * nodes; after that the answer sticks.
+ */
+bool Search::timeUp() {
+    if (stopped || nodes < nextCheck)
+        return stopped;
+    nextCheck = nodes + TIME_CHECK_INTERVAL;
+    if (abortFlag != nullptr && abortFlag->load(std::memory_order_relaxed))
+        stopped = true;
+    else if (nodeLimit > 0 && nodes >= nodeLimit)
+        stopped = true;
+    else if (timed)
+        stopped = SearchClock::now() >= hardStop;
+    return stopped;
+}
+
+/*
+ * Exact score of the finished game on the board for the given side.
+ */
+template <Side side>
+int Search::scoreFinal() {
+    return finalScore(board.getMask<side>(), board.getMask<opponentOf(side)>());
+}
+
+/*
+ * Gives every legal move an ordering score: the hash move first, then
+ * corners, then the two killer moves of this ply, then the rest by history
+ * (and, deep in the tree, by how few replies they leave the opponent) with
+ * the static square priority breaking ties. With ordering switched off the
+ * moves keep their scan order.
+ */
+template <Side side>
+void Search::scoreMoves(MoveList &legalMoves, int scores[], int hashMove, int ply, int depth)
+{
+    uint64_t mine = board.getMask<side>();
+    uint64_t theirs = board.getMask<opponentOf(side)>();
+    bool byMobility = depth >= MOBILITY_ORDER_DEPTH;
+
+    for (int i = 0; i < legalMoves.size; ++i)
+    {
+        int moveId = legalMoves.moves[i];
+        if (!ordering)
+            scores[i] = -i;
+        else if (moveId == hashMove)
+            scores[i] = ORDER_HASH;
+        else if ((CORNERS >> moveId) & 1)
+            scores[i] = ORDER_CORNER + SQUARE_PRIORITY[moveId];
+        else if (moveId == killers[ply][0])
+            scores[i] = ORDER_KILLER1;
+        else if (moveId == killers[ply][1])
+            scores[i] = ORDER_KILLER2;
+        else
+        {
+            scores[i] = (history[side][moveId] << 4) + SQUARE_PRIORITY[moveId];
+            if (byMobility)
+            {
+                uint64_t flips = getFlips(mine, theirs, moveId);
+                int replies = popCount(getMoves(theirs & ~flips, mine | flips | (1ULL << moveId)));
+                scores[i] += (63 - replies) << ORDER_MOBILITY_SHIFT;
+            }
+        }
+    }
+}
+
+/*
+ * Moves the best-scored of the moves from position i on to position i; lazy
+ * selection sort, so a cut-off early in the list skips sorting the rest.
+ */
+static void pickMove(MoveList &legalMoves, int scores[], int i)
+{
+    int best = i;
+    for (int j = i + 1; j < legalMoves.size; ++j)
+        if (scores[j] > scores[best])
+            best = j;
+    if (best != i)
+    {
+        int move = legalMoves.moves[i];
+        legalMoves.moves[i] = legalMoves.moves[best];
+        legalMoves.moves[best] = move;
+        int score = scores[i];
+        scores[i] = scores[best];
+        scores[best] = score;
+    }
+}
+
+/*
+ * Remembers a move that caused a beta cut-off: as a killer for this ply and
+ * in the history table, weighted by the depth of the cut.
+ */
+template <Side side>
+void Search::recordCutoff(int moveId, int ply, int depth)
+{
+    if (killers[ply][0] != moveId)
+    {
+        killers[ply][1] = killers[ply][0];
+        killers[ply][0] = moveId;
+    }
+
+    history[side][moveId] += depth * depth;
+    if (history[side][moveId] >= HISTORY_MAX)
+    {
+        for (int s = 0; s < 2; ++s)
+            for (int sq = 0; sq < 64; ++sq)
+                history[s][sq] /= 2;
+    }
+}
+
+/*
+ * Scores the children of a node one ply above the leaves in batches, rather
+ * than visiting each child to evaluate it. The moves are ordered as usual and
+ * taken BATCH_LANES at a time: each group is generated together and its
+ * mobility (and, without pattern weights, its square weights) computed by
+ * the batch kernels, and no further group is tried once one reaches beta.
+ * Children that end the game get their exact score. Returns the best score
+ * found and sets bestMove to its move.
+ */
+template <Side side>
+int Search::searchFrontier(MoveList &legalMoves, int hashMove, int ply, int beta, int &bestMove)
+{
+    const Side other = opponentOf(side);
+    uint64_t mine = board.getMask<side>();
+    uint64_t theirs = board.getMask<other>();
+
+    int order[MAX_MOVES];
+    scoreMoves<side>(legalMoves, order, hashMove, ply, 1);
+
+    int bestScore = -SCORE_INF;
+    for (int first = 0, count = 1; first < legalMoves.size && bestScore < beta; first += count, count = BATCH_LANES)
+    {
+        if (count > legalMoves.size - first)
+            count = legalMoves.size - first;
+        for (int i = first; i < first + count; ++i)
+            pickMove(legalMoves, order, i);
+
+        // sampled by batch: the node count steps by up to BATCH_LANES here
+        TELEMETRY(uint64_t genStart = telemetrySample(frontierBatches++));
+        ChildBatch children;
+        generateChildren(mine, theirs, legalMoves.moves + first, count, children);
+        nodes += count;
+        TELEMETRY(uint64_t evalStart = genStart ? telemetryTicks() : 0);
+        TELEMETRY(if (genStart) stats.moveGenTicks += evalStart - genStart);
+
+        int scores[BATCH_LANES];
+        if (eval == nullptr)
+        {
+            batchPositional(children, scores);
+        }
+        else
+        {
+            int mobility[BATCH_LANES];
+            batchMobility(children, mobility);
+            for (int i = 0; i < count; ++i)
+            {
+                PatternState child = patterns[patternTop];
+                PatternEval::update(child, children.moves[i], children.flips[i], side);
+                scores[i] = -eval->evaluate(child, children.theirs[i], children.mine[i], other, -mobility[i]);
+            }
+        }
+        // a child where neither side can move ends the game
+        for (int i = 0; i < count; ++i)
+        {
+            if (getMoves(children.theirs[i], children.mine[i]) == 0
+                && getMoves(children.mine[i], children.theirs[i]) == 0)
+                scores[i] = finalScore(children.mine[i], children.theirs[i]);
+        }
+        TELEMETRY(if (evalStart) stats.evalTicks += telemetryTicks() - evalStart);
+
+        for (int i = 0; i < count; ++i)
+        {
+            if (scores[i] > bestScore)
+            {
+                bestScore = scores[i];
+                bestMove = children.moves[i];
+            }
+        }
+        // the first group is the first move alone
+        TELEMETRY(stats.firstMoveCutoffs += first == 0 && bestScore >= beta);
+    }
+    return bestScore;
+}
+
+/*
+ * Multi-ProbCut: predicts the result of a depth-plies search of the current
+ * position from a shallow one, with the fit for the position's stage and the
+ * depth, and cuts the node when the prediction is outside (alpha, beta) by
+ * probCutConfidence standard deviations or more. Each side of the window
+ * costs one null-window search at the shallow depth, at the shallow score
+ * that maps to the window's edge plus the margin. Returns true and sets
+ * score to the edge crossed if the node can be cut.
+ */
+template <Side side>
+bool Search::probCutTest(int depth, int ply, int alpha, int beta, bool passed, int &score)
+{
+    const ProbCutFit *fit = probCut->fit(popCount(board.getMask<side>() | board.getMask<opponentOf(side)>()), depth);
+    if (fit == nullptr)
+        return false;
+    int shallow = ProbCut::shallowDepth(depth);
+    double margin = probCutConfidence * fit->sigma;
+
+    if (beta < SCORE_WIN)
+    {
+        int bound = (int) ceil((beta + margin - fit->intercept) / fit->slope);
+        if (bound < SCORE_WIN && alphaBeta<side>(shallow, ply, bound - 1, bound, passed) >= bound)
+        {
+            score = beta;
+            return true;
+        }
+    }
+    if (alpha > -SCORE_WIN)
+    {
+        int bound = (int) floor((alpha - margin - fit->intercept) / fit->slope);
+        if (bound > -SCORE_WIN && alphaBeta<side>(shallow, ply, bound, bound + 1, passed) <= bound)
+        {
+            score = alpha;
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * Fail-soft negamax alpha-beta with principal-variation search: the first
+ * move is searched with the full window, the rest with a null window around
+ * alpha and re-searched only if they turn out to be better.
+ *
+ * passed tells whether the previous move was a pass; a second pass in a row
+ * ends the game and the position is scored exactly. ply is the distance from
+ * the root, which indexes the killer moves.
+ */
+template <Side side>
+int Search::alphaBeta(int depth, int ply, int alpha, int beta, bool passed)
+{
+    ++nodes;
+    if (timeUp())
+        return 0;  // the result is thrown away by iterativeDeepening()
+    if (depth <= 0)
+    {
+        TELEMETRY(uint64_t evalStart = telemetrySample(nodes));
+        int score = evaluate<side>();
+        TELEMETRY(if (evalStart) stats.evalTicks += telemetryTicks() - evalStart);
+        return score;
+    }
+
+    // a deep enough result for this position may already be known
+    int alphaOrig = alpha;
+    uint64_t key = board.getHash<side>();
+    TTEntry entry;
+    bool hit = tt != nullptr && tt->probe(key, entry);
+    TELEMETRY(stats.ttProbes += tt != nullptr);
+    TELEMETRY(stats.ttHits += hit);
+    int hashMove = hit ? entry.move : PASS;
+    if (hit && entry.depth >= depth)
+    {
+        if (entry.bound == BOUND_EXACT)
+            return entry.score;
+        if (entry.bound == BOUND_LOWER && entry.score >= beta)
+            return entry.score;
+        if (entry.bound == BOUND_UPPER && entry.score <= alpha)
+            return entry.score;
+    }
+
+    // a shallow search may show the deep one is almost surely outside the window
+    int cutScore;
+    if (probCut != nullptr && depth >= PROBCUT_MIN_DEPTH && probCutTest<side>(depth, ply, alpha, beta, passed, cutScore))
+    {
+        TELEMETRY(stats.probCuts++);
+        return cutScore;
+    }
+
+    const Side other = opponentOf(side);
+    MoveList legalMoves;
+    TELEMETRY(uint64_t genStart = telemetrySample(nodes));
+    int moveCount = board.getLegalMoves<side>(legalMoves);
+    TELEMETRY(if (genStart) stats.moveGenTicks += telemetryTicks() - genStart);
+    if (moveCount < 1)
+    {
+        if (passed)  // neither side can move: the game is over
+            return scoreFinal<side>();
+
+        // pass the turn without using up depth
+        playMove<side>(PASS);
+        int score = -alphaBeta<other>(depth, ply + 1, -beta, -alpha, true);
+        takeBack<side>();
+        return score;
+    }
+
+    int bestScore = -SCORE_INF;
+    int bestMove = PASS;
+    if (depth == 1)
+    {
+        // every child is a leaf: score them all in one batch
+        bestScore = searchFrontier<side>(legalMoves, hashMove, ply, beta, bestMove);
+        if (bestScore >= beta)
+        {
+            recordCutoff<side>(bestMove, ply, depth);
+            TELEMETRY(stats.cutoffs++);
+        }
+    }
+    else
+    {
+        int scores[MAX_MOVES];
+        scoreMoves<side>(legalMoves, scores, hashMove, ply, depth);
+        for (int i = 0; i < legalMoves.size; ++i)
+        {
+            pickMove(legalMoves, scores, i);
+            playMove<side>(legalMoves.moves[i]);
+            int score;
+            if (i == 0)
+            {
+                score = -alphaBeta<other>(depth - 1, ply + 1, -beta, -alpha, false);
+            }
+            else
+            {
+                score = -alphaBeta<other>(depth - 1, ply + 1, -alpha - 1, -alpha, false);
+                if (score > alpha && score < beta)
+                    score = -alphaBeta<other>(depth - 1, ply + 1, -beta, -alpha, false);
+            }
+            takeBack<side>();
+            if (stopped)
+                return 0;
+
+            if (score > bestScore)
+            {
+                bestScore = score;
+                bestMove = legalMoves.moves[i];
+                if (score > alpha)
+                {
+                    alpha = score;
+                    if (alpha >= beta)
+                    {
+                        recordCutoff<side>(bestMove, ply, depth);
+                        TELEMETRY(stats.cutoffs++);
+                        TELEMETRY(stats.firstMoveCutoffs += i == 0);
+                        break;  // beta cut-off
+                    }
+                }
+            }
+        }
+    }
+
+    if (tt != nullptr)
+    {
+        Bound bound = bestScore <= alphaOrig ? BOUND_UPPER
+            : bestScore >= beta ? BOUND_LOWER : BOUND_EXACT;
+        tt->store(key, depth, bound, bestScore, bestMove);
+    }
+
+    return bestScore;
+}
+
+/*
+ * Searches every root move to the given depth and returns the best score,
+ * fail-soft within (alpha, beta). bestMove is set to the best move id, or
+ * PASS if the side has no legal move.
+ */
+template <Side side>
+int Search::searchRoot(int depth, int &bestMove, int alpha, int beta)
+{
+    ++nodes;
+    const Side other = opponentOf(side);
+    MoveList legalMoves;
+    if (board.getLegalMoves<side>(legalMoves) < 1)
+    {
+        bestMove = PASS;
+        playMove<side>(PASS);
+        int score = -alphaBeta<other>(depth, 1, -beta, -alpha, true);
+        takeBack<side>();
+        return score;
+    }
+
+    // the previous iteration's best move goes first, or the expected one before that
+    TTEntry entry;
+    int hashMove = hasGuess ? guessMove : PASS;
+    if (tt != nullptr && tt->probe(board.getHash<side>(), entry) && entry.move != PASS)
+        hashMove = entry.move;
+    int scores[MAX_MOVES];
+    scoreMoves<side>(legalMoves, scores, hashMove, 0, depth);
+
+    int alphaOrig = alpha;
+    int bestScore = -SCORE_INF;
+    bestMove = PASS;
+    for (int i = 0; i < legalMoves.size; ++i)
+    {
+        pickMove(legalMoves, scores, i);
+        playMove<side>(legalMoves.moves[i]);
+        int score;
+        if (i == 0)
+        {
+            score = -alphaBeta<other>(depth - 1, 1, -beta, -alpha, false);
+        }
+        else
+        {
+            score = -alphaBeta<other>(depth - 1, 1, -alpha - 1, -alpha, false);
+            if (score > alpha && score < beta)
+                score = -alphaBeta<other>(depth - 1, 1, -beta, -alpha, false);
+        }
+        takeBack<side>();
+        if (stopped)
+            break;
+
+        if (score > bestScore)
+        {
+            bestScore = score;
+            bestMove = legalMoves.moves[i];
+            if (score > alpha)
+            {
+                alpha = score;
+                if (alpha >= beta)
+                    break;  // fails high: the caller widens the window
+            }
+        }
+    }
+
+    if (tt != nullptr && !stopped)
+    {
+        Bound bound = bestScore <= alphaOrig ? BOUND_UPPER
+            : bestScore >= beta ? BOUND_LOWER : BOUND_EXACT;
+        tt->store(board.getHash<side>(), depth, bound, bestScore, bestMove);
+    }
+
+    return bestScore;
+}
+
+// the root searches the runtime searchRoot() dispatches to, for callers
+// outside this file
+template int Search::searchRoot<BLACK>(int depth, int &bestMove, int alpha, int beta);
+template int Search::searchRoot<WHITE>(int depth, int &bestMove, int alpha, int beta);
+
+/*
+ * Iterative deepening: searches depth firstDepth, firstDepth + 1, ... up to
+ * limits.maxDepth and returns the score of the deepest iteration that
+ * completed; bestMove is that iteration's move. A new iteration is not
+ * started after limits.softStop, and the running one is abandoned at
+ * limits.hardStop; likewise with the node budget limits.maxNodes, which
+ * counts all iterations together.
+ *
+ * From ASPIRATION_DEPTH on, an iteration first searches a narrow window
+ * around the score of the one before (or the guess, for the first one), and
+ * widens it only if the score falls outside.
+ *
+ * Depth 1 always completes (unless aborted from another thread), so the
+ * main search always has a move to return. A deeper first iteration that
+ * runs out of time returns the guess it was resumed from, if there is one,
+ * and otherwise falls back on a depth-1 search; neither happens once aborted,
+ * and the guess leaves getDepthReached() at 0.
+ */
+int Search::iterativeDeepening(Side side, const SearchLimits &limits, int &bestMove, int firstDepth)
+{
+    int empties = 64 - board.countBlack() - board.countWhite();
+    int choices = popCount(board.getLegalMoveMask(side));
+    int bestScore = 0;
+    bool haveScore = hasGuess;
+    int expected = guessScore;
+    bestMove = PASS;
+    depthReached = 0;
+    stopped = false;
+    nodes = 0;
+    nextCheck = 0;
+    TELEMETRY(stats.clear());
+    TELEMETRY(uint64_t searchStart = telemetryTicks());
+
+    for (int depth = firstDepth; depth <= limits.maxDepth; ++depth)
+    {
+        if (depth > 1 && limits.timed && SearchClock::now() >= limits.softStop)
+            break;
+        if (depth > 1 && limits.maxNodes > 0 && nodes >= limits.maxNodes)
+            break;
+        if (abortFlag != nullptr && abortFlag->load(std::memory_order_relaxed))
+            break;
+
+        timed = (depth > 1) && limits.timed;
+        hardStop = limits.hardStop;
+        nodeLimit = (depth > 1) ? limits.maxNodes : 0;
+
+        int delta = ASPIRATION_WINDOW;
+        int alpha = -SCORE_INF;
+        int beta = SCORE_INF;
+        if (haveScore && depth >= ASPIRATION_DEPTH && expected > -SCORE_WIN && expected < SCORE_WIN)
+        {
+            alpha = expected - delta;
+            beta = expected + delta;
+        }
+
+        int moveId;
+        int score;
+        while (true)
+        {
+            score = searchRoot(side, depth, moveId, alpha, beta);
+            if (stopped)
+                break;
+            if (score > alpha && score < beta)
+                break;
+
+            delta *= ASPIRATION_GROWTH;
+            if (score <= alpha)
+                alpha = delta > ASPIRATION_MAX ? -SCORE_INF : score - delta;
+            else
+                beta = delta > ASPIRATION_MAX ? SCORE_INF : score + delta;
+        }
+        if (stopped)
+            break;  // incomplete iteration: keep the previous result
+
+        bestScore = score;
+        bestMove = moveId;
+        depthReached = depth;
+        expected = score;
+        haveScore = true;
+
+        // nothing to choose from, or every line already reaches the end of the
+        // game and is scored exactly; not with ProbCut, which also cuts nodes
+        // that deep
+        if (choices <= 1 || (depth >= empties && probCut == nullptr))
+            break;
+    }
+
+    // a deep first iteration ran out of time: keep the guess it was resumed
+    // from, which an earlier search found to about that depth, or else fall
+    // back on depth 1. Not when aborted: a pool helper's result would then
+    // compete with the main search's. The guess is no completed iteration,
+    // so depthReached stays 0.
+    uint64_t legal = board.getLegalMoveMask(side);
+    bool guessLegal = guessMove == PASS ? legal == 0 : ((legal >> guessMove) & 1) != 0;
+    bool aborted = abortFlag != nullptr && abortFlag->load();
+    if (depthReached == 0 && firstDepth > 1 && !aborted && hasGuess && guessLegal)
+    {
+        bestScore = guessScore;
+        bestMove = guessMove;
+    }
+    else if (depthReached == 0 && firstDepth > 1 && !aborted)
+    {
+        stopped = false;
+        timed = false;
+        nodeLimit = 0;
+        bestScore = searchRoot(side, 1, bestMove);
+        depthReached = 1;
+    }
+
+    timed = false;
+    nodeLimit = 0;
+    hasGuess = false;
+    TELEMETRY(stats.totalTicks = telemetryTicks() - searchStart);
+    return bestScore;
+}
+
+/*
+ * Time manager: splits msLeft (the time left for the whole game) over the
+ * moves we still expect to make, i.e. half of the empty squares. Iterations
+ * may start until half of that share has gone, and a running iteration is
+ * cut off at twice the share, never past what is left for the game.
+ * msLeft < 0 means the game is untimed.
+ */
+SearchLimits allocateTime(SearchClock::time_point start, int msLeft, int empties)
+{
+    SearchLimits limits;
+    if (msLeft < 0)
+        return limits;
+
+    int movesLeft = (empties + 1) / 2;
+    if (movesLeft < 1)
+        movesLeft = 1;
+    int available = msLeft - TIME_SAFETY_MS - msLeft / 50;
+    if (available < 0)
+        available = 0;
+    int share = available / movesLeft;
+    int hard = 2 * share < available ? 2 * share : available;
+
+    limits.timed = true;
+    limits.softStop = start + std::chrono::milliseconds(share / 2);
+    limits.hardStop = start + std::chrono::milliseconds(hard);
+    return limits;
+}
+
+/*
+ * Make a pool of the given number of search threads (at least one) sharing
+ * the table.
+ */
+SearchPool::SearchPool(int threads, TranspositionTable *table) {
+    Board start;
+    if (threads < 1)
+        threads = 1;
+    for (int i = 0; i < threads; ++i)
+    {
+        searches.push_back(new Search(start, table));
+        if (i > 0)
+            searches[i]->setAbortFlag(&abortHelpers);
+    }
+    abortHelpers = false;
+    nodes = 0;
+    depthReached = 0;
+    firstDepth = 1;
+}
+
+/*
+ * Destructor for the pool.
+ */
+SearchPool::~SearchPool() {
+    for (Search *search : searches)
+        delete search;
+}
+
+void SearchPool::setMoveOrdering(bool enabled) {
+    for (Search *search : searches)
+        search->setMoveOrdering(enabled);
+}
+
+void SearchPool::setGuess(int moveId, int score, int depth) {
+    for (Search *search : searches)
+        search->setGuess(moveId, score);
+    firstDepth = depth < 1 ? 1 : depth;
+}
+
+void SearchPool::setEvaluation(const PatternEval *weights) {
+    for (Search *search : searches)
+        search->setEvaluation(weights);
+}
+
+void SearchPool::setProbCut(const ProbCut *cuts, double confidence) {
+    for (Search *search : searches)
+        search->setProbCut(cuts, confidence);
+}
+
+/*
+ * Runs the main search in this thread and the helpers alongside it, then
+ * stops the helpers as soon as the main search returns.
+ */
+int SearchPool::search(Board &position, Side side, const SearchLimits &limits, int &bestMove)
+{
+    int helpers = (int) searches.size() - 1;
+    std::vector<std::thread> threads;
+    std::vector<int> helperMoves(helpers + 1, PASS);
+    std::vector<int> helperScores(helpers + 1, 0);
+
+    abortHelpers = false;
+    for (Search *search : searches)
+        search->setPosition(position);
+    for (int i = 1; i <= helpers; ++i)
+    {
+        // odd helpers run one ply ahead of the main thread
+        int helperDepth = firstDepth + (i % 2);
+        threads.push_back(std::thread([this, i, side, &limits, helperDepth, &helperMoves, &helperScores]() {
+            helperScores[i] = searches[i]->iterativeDeepening(side, limits, helperMoves[i], helperDepth);
+        }));
+    }
+
+    int score = searches[0]->iterativeDeepening(side, limits, bestMove, firstDepth);
+    firstDepth = 1;
+    depthReached = searches[0]->getDepthReached();
+
+    abortHelpers = true;
+    for (std::thread &thread : threads)
+        thread.join();
+
+    nodes = 0;
+    stats.clear();
+    for (int i = 0; i <= helpers; ++i)
+    {
+        nodes += searches[i]->getNodes();
+        stats.add(searches[i]->getStats());
+        if (i > 0 && searches[i]->getDepthReached() > depthReached && helperMoves[i] != PASS)
+        {
+            depthReached = searches[i]->getDepthReached();
+            bestMove = helperMoves[i];
+            score = helperScores[i];
+        }
+    }
+    return score;
+}
+
+/*
+ * Follows the best moves stored in the table from the position, as far as
+ * they are legal: the line the last search expects to be played.
+ */
+int probeLine(TranspositionTable &tt, Board position, Side side, int line[], int maxLength)
+{
+    int length = 0;
+    while (length < maxLength)
+    {
+        Side other = (side == BLACK) ? WHITE : BLACK;
+        uint64_t legal = position.getLegalMoveMask(side);
+        int moveId = PASS;
+        if (legal == 0)
+        {
+            if (position.getLegalMoveMask(other) == 0)
+                break;  // the game is over
+        }
+        else
+        {
+            TTEntry entry;
+            if (!tt.probe(position.getHash(side), entry) || entry.move == PASS || !((legal >> entry.move) & 1))
+                break;
+            moveId = entry.move;
+        }
+        position.makeMove(moveId, side);
+        line[length++] = moveId;
+        side = other;
+    }
+    return length;
+}
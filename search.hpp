@@ -0,0 +1,183 @@
+#ifndef __SEARCH_H__
+#define __SEARCH_H__
+
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include "common.hpp"
+#include "board.hpp"
+#include "tt.hpp"
+#include "eval.hpp"
+#include "probcut.hpp"
+#include "telemetry.hpp"
+
+typedef std::chrono::steady_clock SearchClock;
+
+// Bound that no score can reach.
+const int SCORE_INF = 32000;
+// A finished game scores SCORE_WIN plus the final disc margin, so any won
+// ending beats any heuristic score (heuristic scores stay well below it).
+const int SCORE_WIN = 10000;
+// Deepest iteration iterativeDeepening() will start.
+const int MAX_SEARCH_DEPTH = 60;
+
+/*
+ * When an iterative-deepening search has to stop. A node budget, unlike the
+ * clock, stops a single-threaded search at the same point on every run and
+ * every machine.
+ */
+struct SearchLimits {
+    int maxDepth;                       // last iteration to run
+    long long maxNodes;                 // abort the running iteration past this many nodes; 0: no limit
+    bool timed;                         // false: ignore the deadlines below
+    SearchClock::time_point softStop;   // do not start a new iteration after this
+    SearchClock::time_point hardStop;   // abort the running iteration at this point
+
+    SearchLimits() : maxDepth(MAX_SEARCH_DEPTH), maxNodes(0), timed(false) {}
+};
+
+// Splits the time left for the game over the moves we still expect to play.
+SearchLimits allocateTime(SearchClock::time_point start, int msLeft, int empties);
+
+/*
+ * Negamax alpha-beta search with principal-variation (null-window) re-search.
+ * Scores are always from the point of view of the side to move.
+ *
+ * The search works on its own copy of the board and walks it with
+ * makeMove()/undoMove(), so it never touches the caller's board. Results are
+ * cached in an optional transposition table owned by the caller, so that
+ * transposed positions and earlier iterations are not searched again.
+ */
+class Search {
+
+private:
+    Board board;
+    TranspositionTable *tt;     // shared with the owner; may be nullptr
+    long long nodes;
+    long long nextCheck;        // node count of the next look at the clock
+    SearchStats stats;          // only kept up in telemetry builds
+    long long frontierBatches;  // batches scored by searchFrontier(), which samples them by this count
+
+    // leaf evaluation: pattern weights shared with the owner, or nullptr for
+    // Board::calcPositionalScore(); patterns[patternTop] indexes the current position
+    const PatternEval *eval;
+    PatternState patterns[MAX_PLY + 1];
+    int patternTop;
+
+    // Multi-ProbCut parameters shared with the owner, or nullptr for a full-width search
+    const ProbCut *probCut;
+    double probCutConfidence;
+
+    // hard deadline and node budget of the running search (nodeLimit 0: none)
+    bool timed;
+    SearchClock::time_point hardStop;
+    long long nodeLimit;
+    bool stopped;
+    int depthReached;
+    // raised by another thread to end this search early; may be nullptr
+    const std::atomic<bool> *abortFlag;
+
+    // move ordering state
+    bool ordering;
+    int killers[MAX_PLY][2];
+    int history[2][64];
+
+    // what an earlier search expects of this position (see setGuess())
+    bool hasGuess;
+    int guessMove;
+    int guessScore;
+
+    bool timeUp();
+
+    // The search proper is instantiated once per side to move, so that no
+    // node tests the colour; the two instantiations call each other.
+    template <Side side> void scoreMoves(MoveList &legalMoves, int scores[], int hashMove, int ply, int depth);
+    template <Side side> void recordCutoff(int moveId, int ply, int depth);
+
+    template <Side side> void playMove(int moveId);
+    template <Side side> void takeBack();
+    template <Side side> int evaluate();
+
+    template <Side side> int searchFrontier(MoveList &legalMoves, int hashMove, int ply, int beta, int &bestMove);
+    template <Side side> bool probCutTest(int depth, int ply, int alpha, int beta, bool passed, int &score);
+    template <Side side> int alphaBeta(int depth, int ply, int alpha, int beta, bool passed);
+    template <Side side> int scoreFinal();
+    template <Side side> int searchRoot(int depth, int &bestMove, int alpha, int beta);
+
+public:
+    Search(Board &position, TranspositionTable *table = nullptr);
+    ~Search();
+
+    // search a new position, keeping the tables and move-ordering state
+    void setPosition(Board &position);
+    void setAbortFlag(const std::atomic<bool> *flag) { abortFlag = flag; }
+    // evaluate leaves with these pattern weights (nullptr: square weights and mobility)
+    void setEvaluation(const PatternEval *weights);
+    // cut nodes whose deep result a shallow search predicts outside the window
+    // with the given confidence, in standard deviations (nullptr: never)
+    void setProbCut(const ProbCut *cuts, double confidence = PROBCUT_CONFIDENCE);
+
+    // search the root to the given depth within (alpha, beta); bestMove is set to a move id or PASS
+    int searchRoot(Side side, int depth, int &bestMove, int alpha = -SCORE_INF, int beta = SCORE_INF) {
+        return side == BLACK ? searchRoot<BLACK>(depth, bestMove, alpha, beta) : searchRoot<WHITE>(depth, bestMove, alpha, beta);
+    }
+
+    // search depth firstDepth, firstDepth+1, ... keeping the result of the last completed iteration
+    int iterativeDeepening(Side side, const SearchLimits &limits, int &bestMove, int firstDepth = 1);
+
+    // the best move and score an earlier search expects for the next search only:
+    // the move is tried first and the first iterations use a window around the score
+    void setGuess(int moveId, int score);
+
+    // switch hash-move/killer/history ordering off to measure what it saves
+    void setMoveOrdering(bool enabled) { ordering = enabled; }
+
+    long long getNodes() { return nodes; }
+    int getDepthReached() { return depthReached; }
+    const SearchStats &getStats() { return stats; }
+};
+
+/*
+ * Lazy SMP: several Search threads work on the same root position and share
+ * one lock-free transposition table. Helper threads start their iterative
+ * deepening one ply apart, so they fill the table with entries the main
+ * thread is about to need. The main thread runs in the caller and decides
+ * when to stop; its result is used unless a helper completed a deeper
+ * iteration.
+ */
+class SearchPool {
+
+private:
+    std::vector<Search *> searches;
+    std::atomic<bool> abortHelpers;
+    long long nodes;
+    int depthReached;
+    int firstDepth;     // first iteration of the next search
+    SearchStats stats;  // of all threads
+
+public:
+    SearchPool(int threads, TranspositionTable *table);
+    ~SearchPool();
+    SearchPool(const SearchPool &) = delete;
+    SearchPool &operator=(const SearchPool &) = delete;
+
+    int search(Board &position, Side side, const SearchLimits &limits, int &bestMove);
+    // raised by another thread to end the running search early; may be nullptr
+    void setAbortFlag(const std::atomic<bool> *flag) { searches[0]->setAbortFlag(flag); }
+    // resume from an earlier search of this position: start at depth, with its move and score
+    void setGuess(int moveId, int score, int depth);
+    void setMoveOrdering(bool enabled);
+    void setEvaluation(const PatternEval *weights);
+    void setProbCut(const ProbCut *cuts, double confidence = PROBCUT_CONFIDENCE);
+
+    int getThreads() { return (int) searches.size(); }
+    long long getNodes() { return nodes; }
+    int getDepthReached() { return depthReached; }
+    const SearchStats &getStats() { return stats; }
+};
+
+// The line of best moves the table holds from the position, up to maxLength
+// moves (PASS included); returns its length.
+int probeLine(TranspositionTable &tt, Board position, Side side, int line[], int maxLength);
+
+#endif
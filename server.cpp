@@ -0,0 +1,313 @@
+#include <iostream>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "player.hpp"
+using namespace std;
+
+/*
+ * Engine server: many games in one process.
+ *
+ * Games are driven over stdin/stdout with one command per line, each naming
+ * its game by an id of the client's choosing:
+ *
+ *   new <id> <black|white> [position]   start a game in which the engine plays
+ *                                       the given colour; the position is 64
+ *                                       squares in setBoard() form, '.' empty
+ *                                       -> ok <id>
+ *   move <id> <x> <y> <msLeft>          the opponent's move (-1 -1: none yet,
+ *                                       or a pass) and the engine's time left
+ *                                       -> move <id> <x> <y>, once searched
+ *   result <id> [text]                  the game is over; frees it
+ *                                       -> ok <id>
+ *   quit                                finish the searches under way and exit
+ *
+ * Anything wrong, an illegal move included, is answered with "error <id>
+ * <reason>" and leaves the game as it was. Replies to moves come in the
+ * order the searches finish, not the order the moves came in.
+ *
+ * The searches run on a fixed pool of worker threads, one game per worker at
+ * a time; a move that waits for a free worker has the wait taken off its
+ * msLeft, which counts from when the line is read. All games share one transposition table, opening book and set of
+ * pattern weights, so a game costs little more than its board and search
+ * stacks to start and to keep. The server ages the shared table itself,
+ * by one generation per round of moves across the games.
+ */
+
+struct ServerOptions {
+    int workers;
+    int ttSizeMb;
+    PlayerConfig config;    // for every game; threads, pondering and logs are off
+};
+
+/*
+ * One hosted game. busy is set while a search of it is queued or running;
+ * over is set by "result", and the game is freed once it is not busy.
+ */
+struct Game {
+    string id;
+    Player *player;
+    bool busy;
+    bool over;
+};
+
+/*
+ * A search to run: the opponent's move (a pass if none), the time left and
+ * when the move came in; the time spent waiting for a worker is the game's.
+ */
+struct Job {
+    Game *game;
+    PackedMove opponentsMove;
+    int msLeft;
+    SearchClock::time_point queued;
+};
+
+static mutex serverLock;            // guards everything below and the output
+static condition_variable jobReady;
+static deque<Job> jobs;
+static map<string, Game *> games;
+static bool quitting;
+// moves queued since the shared table last started a new generation
+static size_t movesThisGeneration;
+
+/*
+ * Writes one reply line; the caller holds serverLock.
+ */
+static void reply(const string &line) {
+    cout << line << endl;
+}
+
+static void freeGame(Game *game) {
+    delete game->player;
+    delete game;
+}
+
+/*
+ * Worker thread: runs queued searches until quitting and out of work.
+ */
+static void worker() {
+    while (true) {
+        Job job;
+        {
+            unique_lock<mutex> lock(serverLock);
+            jobReady.wait(lock, []() { return !jobs.empty() || quitting; });
+            if (jobs.empty())
+                return;
+            job = jobs.front();
+            jobs.pop_front();
+        }
+
+        int msLeft = job.msLeft;
+        if (msLeft >= 0) {
+            long long waited = chrono::duration_cast<chrono::milliseconds>(SearchClock::now() - job.queued).count();
+            msLeft = waited < msLeft ? msLeft - (int) waited : 0;
+        }
+        PackedMove myMove = job.game->player->play(job.opponentsMove, msLeft);
+        ostringstream line;
+        line << "move " << job.game->id << " ";
+        if (!myMove.isPass())
+            line << myMove.getX() << " " << myMove.getY();
+        else
+            line << "-1 -1";
+
+        lock_guard<mutex> lock(serverLock);
+        reply(line.str());
+        job.game->busy = false;
+        if (job.game->over)
+            freeGame(job.game);
+    }
+}
+
+/*
+ * Carries out one command line, read at received; the caller holds
+ * serverLock. Returns false on "quit".
+ */
+static bool command(const ServerOptions &options, const SharedTables &tables, const string &text,
+                    SearchClock::time_point received) {
+    istringstream in(text);
+    string name, id;
+    in >> name;
+    if (name.empty())
+        return true;
+    if (name == "quit")
+        return false;
+    if (!(in >> id)) {
+        reply("error - missing game id");
+        return true;
+    }
+
+    map<string, Game *>::iterator found = games.find(id);
+    if (name == "new") {
+        string colour, position;
+        in >> colour >> position;
+        if (found != games.end())
+            reply("error " + id + " game exists");
+        else if (colour != "black" && colour != "white")
+            reply("error " + id + " colour must be black or white");
+        else if (!position.empty() && position.size() != 64)
+            reply("error " + id + " position must have 64 squares");
+        else {
+            Game *game = new Game();
+            game->id = id;
+            game->player = new Player(colour == "black" ? BLACK : WHITE, options.config, tables);
+            if (!position.empty())
+                game->player->setBoard(&position[0]);
+            game->busy = false;
+            game->over = false;
+            games[id] = game;
+            reply("ok " + id);
+        }
+    }
+    else if (name == "move") {
+        Job job;
+        int x, y;
+        if (found == games.end())
+            reply("error " + id + " no such game");
+        else if (!(in >> x >> y >> job.msLeft))
+            reply("error " + id + " move needs x, y and msLeft");
+        else if (found->second->busy)
+            reply("error " + id + " still searching");
+        else {
+            // the game is not busy, so its board can be looked at here
+            job.game = found->second;
+            job.queued = received;
+            job.opponentsMove = (x >= 0 && y >= 0) ? PackedMove(x, y) : PackedMove::pass();
+            if (!job.game->player->isLegalReply(job.opponentsMove))
+                reply("error " + id + " illegal move");
+            else {
+                // one generation of the shared table per round of moves, about
+                // one search per game, so that no game ages the others' entries
+                if (++movesThisGeneration >= games.size()) {
+                    tables.tt->newSearch();
+                    movesThisGeneration = 0;
+                }
+                job.game->busy = true;
+                jobs.push_back(job);
+                jobReady.notify_one();
+            }
+        }
+    }
+    else if (name == "result") {
+        if (found == games.end())
+            reply("error " + id + " no such game");
+        else {
+            Game *game = found->second;
+            games.erase(found);
+            game->over = true;
+            if (!game->busy)
+                freeGame(game);
+            reply("ok " + id);
+        }
+    }
+    else
+        reply("error " + id + " unknown command " + name);
+    return true;
+}
+
+static void usage(const char *name) {
+    cerr << "usage: " << name << " [-j workers] [-t MB] [-b book] [-w weights] [-c probcut] [-d depth] [-e empties]" << endl
+         << "  -j  searches run at once (default: one per core)" << endl
+         << "  -t  transposition table shared by all games, in MB (default 256)" << endl
+         << "  -b  opening book, or none (default othello.book)" << endl
+         << "  -w  pattern weights, or square for square weights (default othello.weights)" << endl
+         << "  -c  Multi-ProbCut parameters for those weights, or none (default othello.probcut)" << endl
+         << "  -d  search depth of untimed moves (default 6)" << endl
+         << "  -e  solve exactly from this many empties (default 20)" << endl;
+    exit(-1);
+}
+
+int main(int argc, char *argv[]) {
+    ServerOptions options;
+    options.workers = (int) thread::hardware_concurrency();
+    options.ttSizeMb = 256;
+    options.config.threads = 1;
+    options.config.ponder = false;
+    options.config.verbose = false;
+
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (!strcmp(argv[i], "-j") && hasValue)
+            options.workers = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-t") && hasValue)
+            options.ttSizeMb = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-b") && hasValue) {
+            ++i;
+            options.config.bookPath = strcmp(argv[i], "none") ? argv[i] : "";
+        }
+        else if (!strcmp(argv[i], "-w") && hasValue) {
+            ++i;
+            options.config.patternEval = strcmp(argv[i], "square") != 0;
+            options.config.evalPath = argv[i];
+        }
+        else if (!strcmp(argv[i], "-c") && hasValue) {
+            ++i;
+            options.config.probCutPath = strcmp(argv[i], "none") ? argv[i] : "";
+        }
+        else if (!strcmp(argv[i], "-d") && hasValue)
+            options.config.depth = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-e") && hasValue)
+            options.config.endgameEmpties = atoi(argv[++i]);
+        else
+            usage(argv[0]);
+    }
+    if (options.ttSizeMb < 1 || options.config.depth < 1)
+        usage(argv[0]);
+    if (options.workers < 1)
+        options.workers = 1;
+
+    // the tables every game shares
+    TranspositionTable tt(options.ttSizeMb);
+    OpeningBook book;
+    PatternEval eval;
+    ProbCut probCut;
+    SharedTables tables;
+    tables.tt = &tt;
+    if (!options.config.bookPath.empty() && book.open(options.config.bookPath.c_str())) {
+        cerr << "server: opening book " << book.size() << " positions" << endl;
+        tables.book = &book;
+    }
+    if (options.config.patternEval) {
+        if (eval.load(options.config.evalPath.c_str()))
+            cerr << "server: pattern weights " << options.config.evalPath << endl;
+        tables.eval = &eval;
+    }
+    if (!options.config.probCutPath.empty() && probCut.load(options.config.probCutPath.c_str())) {
+        cerr << "server: Multi-ProbCut parameters " << options.config.probCutPath << endl;
+        tables.probCut = &probCut;
+    }
+
+    vector<thread> workers;
+    for (int i = 0; i < options.workers; i++)
+        workers.push_back(thread(worker));
+    {
+        lock_guard<mutex> lock(serverLock);
+        reply("ready");
+    }
+
+    string line;
+    while (getline(cin, line)) {
+        SearchClock::time_point received = SearchClock::now();
+        lock_guard<mutex> lock(serverLock);
+        if (!command(options, tables, line, received))
+            break;
+    }
+
+    {
+        lock_guard<mutex> lock(serverLock);
+        quitting = true;
+    }
+    jobReady.notify_all();
+    for (thread &t : workers)
+        t.join();
+    for (map<string, Game *>::iterator it = games.begin(); it != games.end(); ++it)
+        freeGame(it->second);
+    return 0;
+}
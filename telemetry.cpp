@@ -0,0 +1,155 @@
+#include "telemetry.hpp"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+void SearchStats::clear() {
+    ttProbes = 0;
+    ttHits = 0;
+    cutoffs = 0;
+    firstMoveCutoffs = 0;
+    probCuts = 0;
+    moveGenTicks = 0;
+    evalTicks = 0;
+    totalTicks = 0;
+}
+
+void SearchStats::add(const SearchStats &other) {
+    ttProbes += other.ttProbes;
+    ttHits += other.ttHits;
+    cutoffs += other.cutoffs;
+    firstMoveCutoffs += other.firstMoveCutoffs;
+    probCuts += other.probCuts;
+    moveGenTicks += other.moveGenTicks;
+    evalTicks += other.evalTicks;
+    totalTicks += other.totalTicks;
+}
+
+PerfCounters::PerfCounters() {
+    opened = false;
+    for (int i = 0; i < NUM_COUNTERS; i++) {
+        fds[i] = -1;
+        startValues[i] = 0;
+    }
+}
+
+PerfCounters::~PerfCounters() {
+#ifdef __linux__
+    for (int i = 0; i < NUM_COUNTERS; i++)
+        if (fds[i] >= 0)
+            close(fds[i]);
+#endif
+}
+
+/*
+ * Opens the counters for user-space work of this thread and every thread
+ * started from now on (inherit), so that the search threads are included.
+ * Counts of a thread reach the total when it exits, which the search
+ * threads do before each search returns.
+ */
+void PerfCounters::open() {
+#ifdef __linux__
+    static const uint64_t EVENTS[NUM_COUNTERS] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES
+    };
+    if (opened)
+        return;
+    for (int i = 0; i < NUM_COUNTERS; i++) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = EVENTS[i];
+        attr.inherit = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fds[i] = (int) syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+        if (fds[i] < 0) {
+            for (int j = 0; j < i; j++) {
+                close(fds[j]);
+                fds[j] = -1;
+            }
+            return;
+        }
+    }
+    opened = true;
+#endif
+}
+
+bool PerfCounters::read(uint64_t values[]) {
+#ifdef __linux__
+    if (!opened)
+        return false;
+    for (int i = 0; i < NUM_COUNTERS; i++)
+        if (::read(fds[i], &values[i], sizeof(uint64_t)) != (ssize_t) sizeof(uint64_t))
+            return false;
+    return true;
+#else
+    return false;
+#endif
+}
+
+void PerfCounters::start() {
+    if (!read(startValues))
+        for (int i = 0; i < NUM_COUNTERS; i++)
+            startValues[i] = 0;
+}
+
+bool PerfCounters::stop(uint64_t &cycles, uint64_t &instructions, uint64_t &cacheMisses) {
+    uint64_t values[NUM_COUNTERS];
+    if (!read(values))
+        return false;
+    cycles = values[0] - startValues[0];
+    instructions = values[1] - startValues[1];
+    cacheMisses = values[2] - startValues[2];
+    return true;
+}
+
+/*
+ * count / total, or 0 when nothing was counted.
+ */
+static double ratio(double count, double total) {
+    return total > 0 ? count / total : 0.0;
+}
+
+/*
+ * One line, keys in a fixed order:
+ *   nps            nodes per second of the move's wall time
+ *   ebf            effective branching factor, the depth-th root of the nodes
+ *   tt_hit_rate    table probes that found the position
+ *   first_cutoff_rate  beta cut-offs made by the first move tried
+ *   probcuts       nodes cut by Multi-ProbCut
+ *   movegen_share, eval_share  of the search's time (all threads), estimated
+ *                  from the sampled nodes
+ *   cycles, instructions, cache_misses  null without hardware counters
+ */
+void emitTelemetry(const MoveTelemetry &record) {
+    const SearchStats &stats = record.stats;
+    double ebf = 0;
+    if (record.depth > 0 && record.nodes > 0)
+        ebf = pow((double) record.nodes, 1.0 / record.depth);
+
+    char counters[128];
+    if (record.hasCounters)
+        snprintf(counters, sizeof(counters), "\"cycles\":%llu,\"instructions\":%llu,\"cache_misses\":%llu",
+                 (unsigned long long) record.cycles, (unsigned long long) record.instructions,
+                 (unsigned long long) record.cacheMisses);
+    else
+        snprintf(counters, sizeof(counters), "\"cycles\":null,\"instructions\":null,\"cache_misses\":null");
+
+    fprintf(stderr, "{\"side\":\"%s\",\"empties\":%d,\"source\":\"%s\",\"move\":\"%s\",\"ms\":%.3f,"
+            "\"nodes\":%lld,\"nps\":%.0f,\"depth\":%d,\"score\":%d,\"threads\":%d,\"ebf\":%.3f,"
+            "\"tt_hit_rate\":%.4f,\"first_cutoff_rate\":%.4f,\"probcuts\":%lld,\"movegen_share\":%.4f,\"eval_share\":%.4f,%s}\n",
+            record.side == BLACK ? "black" : "white", record.empties, record.source,
+            squareName(record.move).c_str(), record.ms,
+            record.nodes, ratio(record.nodes, record.ms / 1000), record.depth, record.score, record.threads, ebf,
+            ratio(stats.ttHits, stats.ttProbes), ratio(stats.firstMoveCutoffs, stats.cutoffs), stats.probCuts,
+            ratio(stats.moveGenTicks * TELEMETRY_SAMPLE, stats.totalTicks),
+            ratio(stats.evalTicks * TELEMETRY_SAMPLE, stats.totalTicks), counters);
+}
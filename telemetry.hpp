@@ -0,0 +1,125 @@
+#ifndef __TELEMETRY_H__
+#define __TELEMETRY_H__
+
+#include <cstdint>
+#include "common.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+
+/*
+ * Search telemetry: per-move counters from the search, optionally the CPU's
+ * hardware counters, written as one JSON line per move on stderr.
+ *
+ * Built only with "make TELEMETRY=1", which defines OTHELLO_TELEMETRY (run
+ * "make clean" when switching). Otherwise every TELEMETRY() statement
+ * disappears, so the search does not pay for a single counter.
+ */
+#ifdef OTHELLO_TELEMETRY
+#define TELEMETRY(statement) statement
+#else
+#define TELEMETRY(statement)
+#endif
+
+/*
+ * A timestamp for measuring short stretches of code: the time-stamp counter
+ * on x86, nanoseconds elsewhere.
+ */
+inline uint64_t telemetryTicks() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// Only nodes (and frontier batches) whose count is a multiple of this time
+// their move generation and evaluation, which keeps the clock reads cheap;
+// emitTelemetry() scales those times back up.
+const int TELEMETRY_SAMPLE = 16;
+
+/*
+ * A start time for a stretch at node number nodes if it is sampled, else 0.
+ */
+inline uint64_t telemetrySample(long long nodes) {
+    return nodes % TELEMETRY_SAMPLE == 0 ? telemetryTicks() : 0;
+}
+
+/*
+ * What one search did, besides counting nodes.
+ */
+struct SearchStats {
+    long long ttProbes;
+    long long ttHits;
+    long long cutoffs;              // beta cut-offs
+    long long firstMoveCutoffs;     // of those, by the first move tried
+    long long probCuts;             // nodes cut by Multi-ProbCut
+    uint64_t moveGenTicks;          // in legal-move and child generation, sampled nodes only
+    uint64_t evalTicks;             // in leaf evaluation, sampled nodes only
+    uint64_t totalTicks;            // in the whole search
+
+    SearchStats() { clear(); }
+    void clear();
+    // adds another thread's counts
+    void add(const SearchStats &other);
+};
+
+/*
+ * Cycle, instruction and cache-miss counters of this process from
+ * perf_event_open(), including the threads it starts later on. Where they
+ * cannot be opened (other systems, no permission) available() is false.
+ */
+class PerfCounters {
+
+private:
+    static const int NUM_COUNTERS = 3;
+    int fds[NUM_COUNTERS];
+    uint64_t startValues[NUM_COUNTERS];
+    bool opened;
+
+    bool read(uint64_t values[]);
+
+public:
+    PerfCounters();
+    ~PerfCounters();
+    PerfCounters(const PerfCounters &) = delete;
+    PerfCounters &operator=(const PerfCounters &) = delete;
+
+    void open();
+    bool available() { return opened; }
+    void start();
+    // cycles, instructions and cache misses since start(); false if unavailable
+    bool stop(uint64_t &cycles, uint64_t &instructions, uint64_t &cacheMisses);
+};
+
+/*
+ * Everything reported about one move.
+ */
+struct MoveTelemetry {
+    Side side;
+    int empties;
+    const char *source;     // "book", "search", "endgame", or the simple mode's name
+    int move;               // move id, or PASS
+    double ms;
+    long long nodes;
+    int depth;              // completed iterations; the empties for an exact solve
+    int score;
+    int threads;
+    SearchStats stats;
+    bool hasCounters;
+    uint64_t cycles;
+    uint64_t instructions;
+    uint64_t cacheMisses;
+
+    MoveTelemetry() : side(BLACK), empties(0), source("search"), move(PASS), ms(0), nodes(0), depth(0),
+        score(0), threads(1), hasCounters(false), cycles(0), instructions(0), cacheMisses(0) {}
+};
+
+// writes the record as one JSON line on stderr
+void emitTelemetry(const MoveTelemetry &record);
+
+#endif
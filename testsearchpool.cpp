@@ -0,0 +1,59 @@
+#include <iostream>
+#include "common.hpp"
+#include "board.hpp"
+#include "search.hpp"
+
+// Checks that a Lazy SMP pool resumed from a guess plays the move its main
+// thread searched: a helper that completes no iteration must not replace it
+// with the guess. The odd helper starts one ply past the depth limit, so it
+// never completes one.
+int main(int argc, char *argv[]) {
+
+    // a midgame position, black to move (FFO notation: X black, O white)
+    const char *squares = "-----O-----X-O-OO-XXXXOXOOXXOO-XOXXOXOOX-XXXXXOX---XOO----XXXXXX";
+    char boardData[64];
+    for (int sq = 0; sq < 64; sq++)
+        boardData[sq] = squares[sq] == 'X' ? 'b' : squares[sq] == 'O' ? 'w' : ' ';
+    Board board;
+    board.setBoard(boardData);
+    const int depth = 4;
+
+    SearchLimits limits;
+    limits.maxDepth = depth;
+    limits.timed = true;
+    limits.softStop = SearchClock::now() + std::chrono::milliseconds(2000);
+    limits.hardStop = limits.softStop;
+
+    // a legal guess that a single search resumed from it does not keep
+    MoveList legalMoves;
+    board.getLegalMoves(BLACK, legalMoves);
+    int guess = PASS;
+    int expected = PASS;
+    for (int i = 0; i < legalMoves.size && guess == PASS; i++) {
+        TranspositionTable tt(4);
+        Search search(board, &tt);
+        search.setGuess(legalMoves.moves[i], 0);
+        int moveId;
+        search.iterativeDeepening(BLACK, limits, moveId, depth);
+        if (moveId != legalMoves.moves[i]) {
+            guess = legalMoves.moves[i];
+            expected = moveId;
+        }
+    }
+
+    TranspositionTable tt(4);
+    SearchPool pool(2, &tt);
+    pool.setGuess(guess, 0, depth);
+    int moveId;
+    pool.search(board, BLACK, limits, moveId);
+
+    if (guess != PASS && moveId == expected && pool.getDepthReached() == depth) {
+        std::cout << "Correct move: " << squareName(expected) << " (guess " << squareName(guess) << ")" << std::endl;
+    } else {
+        std::cout << "Wrong move: got " << squareName(moveId) << " at depth " << pool.getDepthReached()
+                  << ", expected " << squareName(expected) << " at depth " << depth << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,506 @@
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+#include "endgame.hpp"
+#include "eval.hpp"
+#include "search.hpp"
+using namespace std;
+
+/*
+ * Offline training of the pattern weights.
+ *
+ * 1. Self-play: games from a few random plies, then shallow searches with
+ *    an occasional random move so that the positions vary.
+ * 2. Labelling, on all cores alongside the self-play: positions with at
+ *    most -e empties get their exact score from the endgame solver. Earlier
+ *    positions get a depth -d search with the -i weights, or, without
+ *    those, the exact score of the game's first position in solver range
+ *    (the result of the game with perfect play from there).
+ * 3. Fitting, one stage per thread: the weights of each stage are fitted to
+ *    its labels by ridge-regularised least squares, solved by conjugate
+ *    gradients; the ridge term keeps rare pattern configurations near zero.
+ *
+ * Labels and weights are in units of 1/LABEL_SCALE disc, so the trained
+ * evaluation estimates the final disc margin. Labelled positions can be
+ * saved (-s) and fitted again later (-l) without playing them again.
+ */
+
+// Evaluation units per disc of final margin.
+static const int LABEL_SCALE = 16;
+// Every TEST_EVERY-th position of a stage is held out to measure the fit.
+static const int TEST_EVERY = 10;
+// Ridge term of the least-squares fit, pulling weights seen in few
+// positions towards zero.
+static const double RIDGE = 4.0;
+// Transposition table of each worker, in MB.
+static const int WORKER_TT_MB = 8;
+
+struct TrainOptions {
+    int games;
+    int openingPlies;
+    int playDepth;
+    double randomRate;      // share of self-play moves picked at random
+    int exactEmpties;
+    int labelDepth;
+    int threads;
+    int epochs;
+    unsigned seed;
+    const char *input;      // weights for the search labels and the start of the fit
+    const char *output;
+    const char *samplesIn;
+    const char *samplesOut;
+};
+
+/*
+ * A labelled position: the score for the side to move, in evaluation units.
+ */
+struct Sample {
+    uint64_t black;
+    uint64_t white;
+    int16_t label;
+    uint8_t blackToMove;
+    uint8_t reserved[5];
+};
+
+static const char SAMPLES_MAGIC[8] = { 'O', 'T', 'H', 'S', 'M', 'P', 'L', '1' };
+
+static PatternEval inputEval;
+static bool haveInput;
+static atomic<int> nextGame;
+static mutex samplesLock;
+static vector<Sample> samples;
+
+/*
+ * Sets board up with the position of the sample.
+ */
+static void samplePosition(const Sample &sample, Board &board) {
+    char data[64];
+    for (int sq = 0; sq < 64; sq++)
+        data[sq] = ((sample.black >> sq) & 1) ? 'b' : ((sample.white >> sq) & 1) ? 'w' : ' ';
+    board.setBoard(data);
+}
+
+/*
+ * Search score for the side to move turned into evaluation units: a
+ * finished game's SCORE_WIN-based score becomes its disc margin.
+ */
+static int labelFromSearch(int score) {
+    if (score > SCORE_WIN / 2)
+        return (score - SCORE_WIN) * LABEL_SCALE;
+    if (score < -SCORE_WIN / 2)
+        return (score + SCORE_WIN) * LABEL_SCALE;
+    return score;
+}
+
+/*
+ * Plays one self-play game and labels its positions.
+ */
+static void playGame(const TrainOptions &options, int game, TranspositionTable &tt, vector<Sample> &out) {
+    mt19937 random(options.seed + 7919u * game);
+    uniform_real_distribution<double> chance(0.0, 1.0);
+    Board board;
+    Search search(board, &tt);
+    if (haveInput)
+        search.setEvaluation(&inputEval);
+    EndgameSolver solver(&tt);
+
+    vector<Sample> positions;
+    Side side = BLACK;
+    for (int ply = 0; !board.isDone(); ply++) {
+        Side other = (side == BLACK) ? WHITE : BLACK;
+        MoveList legalMoves;
+        if (board.getLegalMoves(side, legalMoves) == 0) {
+            board.makeMove(PASS, side);
+            side = other;
+            continue;
+        }
+
+        Sample sample;
+        memset(&sample, 0, sizeof(sample));
+        sample.black = board.getMask(BLACK);
+        sample.white = board.getMask(WHITE);
+        sample.blackToMove = side == BLACK;
+        positions.push_back(sample);
+
+        int moveId;
+        if (ply < options.openingPlies || chance(random) < options.randomRate)
+            moveId = legalMoves.moves[random() % legalMoves.size];
+        else {
+            SearchLimits limits;
+            limits.maxDepth = options.playDepth;
+            tt.newSearch();
+            search.setPosition(board);
+            search.iterativeDeepening(side, limits, moveId);
+        }
+        board.makeMove(moveId, side);
+        side = other;
+    }
+
+    // the exact result from the first position the solver can take on
+    int outcome = 0;
+    bool outcomeBlack = true;
+    bool haveOutcome = false;
+    for (Sample &sample : positions) {
+        int empties = 64 - popCount(sample.black | sample.white);
+        if (empties > options.exactEmpties)
+            continue;
+
+        Board position;
+        samplePosition(sample, position);
+        Side toMove = sample.blackToMove ? BLACK : WHITE;
+        int moveId;
+        tt.newSearch();
+        sample.label = solver.solveRoot(position, toMove, moveId) * LABEL_SCALE;
+        if (!haveOutcome) {
+            outcome = sample.label;
+            outcomeBlack = sample.blackToMove;
+            haveOutcome = true;
+        }
+    }
+    if (!haveOutcome) {
+        // the game ended early: its final margin, from black's side
+        outcome = (board.countBlack() - board.countWhite()) * LABEL_SCALE;
+        outcomeBlack = true;
+    }
+
+    for (Sample &sample : positions) {
+        int empties = 64 - popCount(sample.black | sample.white);
+        if (empties <= options.exactEmpties)
+            continue;
+        if (options.labelDepth > 0 && haveInput) {
+            Board position;
+            samplePosition(sample, position);
+            SearchLimits limits;
+            limits.maxDepth = options.labelDepth;
+            int moveId;
+            tt.newSearch();
+            search.setPosition(position);
+            sample.label = labelFromSearch(search.iterativeDeepening(sample.blackToMove ? BLACK : WHITE, limits, moveId));
+        }
+        else
+            sample.label = (sample.blackToMove == outcomeBlack) ? outcome : -outcome;
+    }
+    out.insert(out.end(), positions.begin(), positions.end());
+}
+
+/*
+ * Worker thread: plays and labels games until none are left.
+ */
+static void generateWorker(const TrainOptions &options) {
+    TranspositionTable tt(WORKER_TT_MB);
+    vector<Sample> mine;
+    for (int game = nextGame++; game < options.games; game = nextGame++) {
+        playGame(options, game, tt, mine);
+        if ((game + 1) % 100 == 0)
+            cerr << "trainer: " << game + 1 << "/" << options.games << " games" << endl;
+    }
+    lock_guard<mutex> lock(samplesLock);
+    samples.insert(samples.end(), mine.begin(), mine.end());
+}
+
+/*
+ * The model's features of one position: the weight of each pattern
+ * instance (counted for black, so turned round when white is to move),
+ * the board features and parity for the side to move.
+ */
+struct Features {
+    int index[NUM_PATTERNS];
+    float sign;
+    float feature[NUM_FEATURES];
+    float parity;
+    float label;
+};
+
+// Weights of a stage besides the pattern tables: the features, then parity.
+static const int EXTRA_WEIGHTS = NUM_FEATURES + 1;
+
+static Features featuresOf(const Sample &sample) {
+    Features f;
+    Board board;
+    samplePosition(sample, board);
+    PatternState state;
+    PatternEval::initState(board, state);
+    for (int i = 0; i < NUM_PATTERNS; i++)
+        f.index[i] = PatternEval::weightIndex(state, i);
+
+    uint64_t mine = sample.blackToMove ? sample.black : sample.white;
+    uint64_t theirs = sample.blackToMove ? sample.white : sample.black;
+    int discs = popCount(sample.black | sample.white);
+    f.sign = sample.blackToMove ? 1.0f : -1.0f;
+    FeatureVector features;
+    computeFeatures(mine, theirs, features);
+    for (int k = 0; k < NUM_FEATURES; k++)
+        f.feature[k] = (float) features.value[k];
+    f.parity = ((64 - discs) & 1) ? 1.0f : -1.0f;
+    f.label = sample.label;
+    return f;
+}
+
+/*
+ * The model's score of a position for weights v: the pattern weights at
+ * v[0 .. size), the feature weights at v[size + k] and the parity weight at
+ * v[size + NUM_FEATURES].
+ */
+static double predict(const Features &f, const vector<double> &v, int size) {
+    double patterns = 0;
+    for (int i = 0; i < NUM_PATTERNS; i++)
+        patterns += v[f.index[i]];
+    double score = f.sign * patterns + v[size + NUM_FEATURES] * f.parity;
+    for (int k = 0; k < NUM_FEATURES; k++)
+        score += v[size + k] * f.feature[k];
+    return score;
+}
+
+/*
+ * Adds the position's features times u to out (one row of X' u).
+ */
+static void scatter(const Features &f, double u, vector<double> &out, int size) {
+    for (int i = 0; i < NUM_PATTERNS; i++)
+        out[f.index[i]] += f.sign * u;
+    for (int k = 0; k < NUM_FEATURES; k++)
+        out[size + k] += f.feature[k] * u;
+    out[size + NUM_FEATURES] += f.parity * u;
+}
+
+static double dot(const vector<double> &a, const vector<double> &b) {
+    double sum = 0;
+    for (size_t j = 0; j < a.size(); j++)
+        sum += a[j] * b[j];
+    return sum;
+}
+
+/*
+ * Fits the weights of one stage and writes them into weights; reports the
+ * error on the fitted and the held-out positions.
+ */
+static void fitStage(const TrainOptions &options, int stage, const vector<Sample> &all, PatternEval &weights) {
+    vector<Features> train, test;
+    for (const Sample &sample : all) {
+        if (PatternEval::stageOf(popCount(sample.black | sample.white)) != stage)
+            continue;
+        if ((train.size() + test.size()) % TEST_EVERY == TEST_EVERY - 1)
+            test.push_back(featuresOf(sample));
+        else
+            train.push_back(featuresOf(sample));
+    }
+
+    // the pattern weights, then the features and parity
+    int size = PatternEval::tableSize();
+    int columns = size + EXTRA_WEIGHTS;
+    int16_t *table = weights.table(stage);
+    vector<double> w(columns);
+    for (int j = 0; j < size; j++)
+        w[j] = table[j];
+    for (int k = 0; k < NUM_FEATURES; k++)
+        w[size + k] = weights.feature(stage, (Feature) k);
+    w[size + NUM_FEATURES] = weights.parity(stage);
+
+    // conjugate gradients on (X'X + RIDGE) w = X'y, starting from r = X'y - (X'X + RIDGE) w
+    vector<double> r(columns), p, product(columns);
+    for (int j = 0; j < columns; j++)
+        r[j] = -RIDGE * w[j];
+    for (const Features &f : train)
+        scatter(f, f.label - predict(f, w, size), r, size);
+    p = r;
+    double residual = dot(r, r);
+    for (int iteration = 0; iteration < options.epochs && residual > 1e-9; iteration++) {
+        for (int j = 0; j < columns; j++)
+            product[j] = RIDGE * p[j];
+        for (const Features &f : train)
+            scatter(f, predict(f, p, size), product, size);
+        double step = residual / dot(p, product);
+        for (int j = 0; j < columns; j++) {
+            w[j] += step * p[j];
+            r[j] -= step * product[j];
+        }
+        double next = dot(r, r);
+        for (int j = 0; j < columns; j++)
+            p[j] = r[j] + (next / residual) * p[j];
+        residual = next;
+    }
+
+    double trainError = 0;
+    for (const Features &f : train) {
+        double error = f.label - predict(f, w, size);
+        trainError += error * error;
+    }
+    trainError = train.empty() ? 0 : sqrt(trainError / train.size());
+
+    for (int j = 0; j < size; j++)
+        table[j] = (int16_t) max(-32000.0, min(32000.0, round(w[j])));
+    for (int k = 0; k < NUM_FEATURES; k++)
+        weights.feature(stage, (Feature) k) = (int16_t) round(w[size + k]);
+    weights.parity(stage) = (int16_t) round(w[size + NUM_FEATURES]);
+
+    // the held-out error of the rounded weights, as the engine will use them
+    double squares = 0;
+    for (const Features &f : test) {
+        int patterns = 0;
+        for (int i = 0; i < NUM_PATTERNS; i++)
+            patterns += table[f.index[i]];
+        double score = f.sign * patterns + weights.parity(stage) * f.parity;
+        for (int k = 0; k < NUM_FEATURES; k++)
+            score += weights.feature(stage, (Feature) k) * f.feature[k];
+        double error = f.label - score;
+        squares += error * error;
+    }
+    double testError = test.empty() ? 0 : sqrt(squares / test.size());
+
+    lock_guard<mutex> lock(samplesLock);
+    fprintf(stderr, "stage %2d: %7zu positions, error %.2f discs fitted, %.2f held out\n",
+            stage, train.size() + test.size(), trainError / LABEL_SCALE, testError / LABEL_SCALE);
+}
+
+static bool saveSamples(const char *path) {
+    FILE *file = fopen(path, "wb");
+    if (file == nullptr)
+        return false;
+    bool ok = fwrite(SAMPLES_MAGIC, sizeof(SAMPLES_MAGIC), 1, file) == 1
+        && fwrite(samples.data(), sizeof(Sample), samples.size(), file) == samples.size();
+    return fclose(file) == 0 && ok;
+}
+
+static bool loadSamples(const char *path) {
+    FILE *file = fopen(path, "rb");
+    if (file == nullptr)
+        return false;
+    char magic[8];
+    bool ok = fread(magic, sizeof(magic), 1, file) == 1 && memcmp(magic, SAMPLES_MAGIC, sizeof(magic)) == 0;
+    Sample sample;
+    while (ok && fread(&sample, sizeof(sample), 1, file) == 1)
+        samples.push_back(sample);
+    fclose(file);
+    return ok;
+}
+
+static void usage(const char *name) {
+    cerr << "usage: " << name << " [options]" << endl
+         << "  -g  self-play games (default 2000)" << endl
+         << "  -o  random plies at the start of each game (default 8)" << endl
+         << "  -p  search depth of the self-play moves (default 4)" << endl
+         << "  -r  share of self-play moves played at random (default 0.1)" << endl
+         << "  -e  label exactly from this many empties (default 14)" << endl
+         << "  -d  label earlier positions with a search this deep; needs -i (default: game result)" << endl
+         << "  -i  weights to search with, and to start the fit from" << endl
+         << "  -j  threads (default: one per core)" << endl
+         << "  -n  conjugate-gradient iterations per stage (default 50)" << endl
+         << "  -x  seed (default 1)" << endl
+         << "  -s  save the labelled positions to this file" << endl
+         << "  -l  fit positions from this file instead of playing games" << endl
+         << "  -w  weights file to write (default othello.weights)" << endl;
+    exit(-1);
+}
+
+int main(int argc, char *argv[]) {
+    TrainOptions options;
+    options.games = 2000;
+    options.openingPlies = 8;
+    options.playDepth = 4;
+    options.randomRate = 0.1;
+    options.exactEmpties = 14;
+    options.labelDepth = 0;
+    options.threads = (int) thread::hardware_concurrency();
+    options.epochs = 50;
+    options.seed = 1;
+    options.input = nullptr;
+    options.output = "othello.weights";
+    options.samplesIn = nullptr;
+    options.samplesOut = nullptr;
+
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (!strcmp(argv[i], "-g") && hasValue)
+            options.games = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-o") && hasValue)
+            options.openingPlies = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-p") && hasValue)
+            options.playDepth = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-r") && hasValue)
+            options.randomRate = atof(argv[++i]);
+        else if (!strcmp(argv[i], "-e") && hasValue)
+            options.exactEmpties = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-d") && hasValue)
+            options.labelDepth = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-i") && hasValue)
+            options.input = argv[++i];
+        else if (!strcmp(argv[i], "-j") && hasValue)
+            options.threads = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-n") && hasValue)
+            options.epochs = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-x") && hasValue)
+            options.seed = (unsigned) atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-s") && hasValue)
+            options.samplesOut = argv[++i];
+        else if (!strcmp(argv[i], "-l") && hasValue)
+            options.samplesIn = argv[++i];
+        else if (!strcmp(argv[i], "-w") && hasValue)
+            options.output = argv[++i];
+        else
+            usage(argv[0]);
+    }
+    if (options.playDepth < 1 || options.exactEmpties < 0 || options.epochs < 0)
+        usage(argv[0]);
+    if (options.threads < 1)
+        options.threads = 1;
+
+    // the fit starts from zero, or from the given weights
+    PatternEval weights;
+    for (int stage = 0; stage < NUM_STAGES; stage++) {
+        memset(weights.table(stage), 0, PatternEval::tableSize() * sizeof(int16_t));
+        for (int k = 0; k < NUM_FEATURES; k++)
+            weights.feature(stage, (Feature) k) = 0;
+        weights.parity(stage) = 0;
+    }
+    if (options.input != nullptr) {
+        if (!inputEval.load(options.input) || !weights.load(options.input)) {
+            cerr << "cannot read weights " << options.input << endl;
+            return 1;
+        }
+        haveInput = true;
+    }
+
+    if (options.samplesIn != nullptr) {
+        if (!loadSamples(options.samplesIn)) {
+            cerr << "cannot read positions " << options.samplesIn << endl;
+            return 1;
+        }
+    }
+    else {
+        vector<thread> workers;
+        for (int i = 0; i < options.threads; i++)
+            workers.push_back(thread(generateWorker, cref(options)));
+        for (thread &t : workers)
+            t.join();
+    }
+    cerr << "trainer: " << samples.size() << " labelled positions" << endl;
+    if (options.samplesOut != nullptr && !saveSamples(options.samplesOut)) {
+        cerr << "cannot write positions " << options.samplesOut << endl;
+        return 1;
+    }
+
+    // stages are independent: fit them side by side
+    atomic<int> nextStage(0);
+    vector<thread> fitters;
+    for (int i = 0; i < options.threads && i < NUM_STAGES; i++)
+        fitters.push_back(thread([&]() {
+            for (int stage = nextStage++; stage < NUM_STAGES; stage = nextStage++)
+                fitStage(options, stage, samples, weights);
+        }));
+    for (thread &t : fitters)
+        t.join();
+
+    if (!weights.save(options.output)) {
+        cerr << "cannot write weights " << options.output << endl;
+        return 1;
+    }
+    cerr << "trainer: weights written to " << options.output << endl;
+    return 0;
+}
@@ -0,0 +1,134 @@
+#include "tt.hpp"
+#include <cstdlib>
+#include <new>
+
+/*
+ * Layout of the data word of a slot.
+ */
+static const int SCORE_SHIFT = 0;       // 16 bits, signed
+static const int MOVE_SHIFT = 16;       // 8 bits, move id + 1 (0 = none)
+static const int DEPTH_SHIFT = 24;      // 8 bits
+static const int BOUND_SHIFT = 32;      // 2 bits
+static const int GENERATION_SHIFT = 34; // 8 bits
+
+static uint64_t packData(int depth, Bound bound, int score, int move, unsigned generation) {
+    return ((uint64_t)(uint16_t)(int16_t)score << SCORE_SHIFT)
+        | ((uint64_t)(uint8_t)(move + 1) << MOVE_SHIFT)
+        | ((uint64_t)(uint8_t)depth << DEPTH_SHIFT)
+        | ((uint64_t)bound << BOUND_SHIFT)
+        | ((uint64_t)(generation & 0xFF) << GENERATION_SHIFT);
+}
+
+static int dataDepth(uint64_t data) {
+    return (data >> DEPTH_SHIFT) & 0xFF;
+}
+
+static unsigned dataGeneration(uint64_t data) {
+    return (data >> GENERATION_SHIFT) & 0xFF;
+}
+
+/*
+ * Make a table of about the given size; the bucket count is rounded down to
+ * a power of two.
+ */
+TranspositionTable::TranspositionTable(size_t megabytes) {
+    size_t count = 1;
+    while (count * 2 * sizeof(Bucket) <= megabytes * 1024 * 1024)
+        count *= 2;
+
+    void *memory = nullptr;
+    if (posix_memalign(&memory, sizeof(Bucket), count * sizeof(Bucket)) != 0)
+        throw std::bad_alloc();
+    buckets = static_cast<Bucket *>(memory);
+    for (size_t i = 0; i < count; i++)
+        new (&buckets[i]) Bucket();
+    bucketMask = count - 1;
+    generation = 0;
+    clear();
+}
+
+/*
+ * Destructor for the table.
+ */
+TranspositionTable::~TranspositionTable() {
+    for (size_t i = 0; i <= bucketMask; i++)
+        buckets[i].~Bucket();
+    free(buckets);
+}
+
+/*
+ * Forgets every entry.
+ */
+void TranspositionTable::clear() {
+    for (size_t i = 0; i <= bucketMask; i++) {
+        for (int j = 0; j < BUCKET_SLOTS; j++) {
+            buckets[i].slots[j].check.store(0, std::memory_order_relaxed);
+            buckets[i].slots[j].data.store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+/*
+ * Starts a new search generation.
+ */
+void TranspositionTable::newSearch() {
+    generation.fetch_add(1, std::memory_order_relaxed);
+}
+
+/*
+ * Looks the key up; returns true and fills entry on a hit.
+ */
+bool TranspositionTable::probe(uint64_t key, TTEntry &entry) {
+    Bucket &bucket = buckets[key & bucketMask];
+    for (int i = 0; i < BUCKET_SLOTS; i++) {
+        const Slot &slot = bucket.slots[i];
+        uint64_t data = slot.data.load(std::memory_order_relaxed);
+        uint64_t check = slot.check.load(std::memory_order_relaxed);
+        if (data != 0 && (check ^ data) == key) {
+            entry.score = (int16_t)(uint16_t)(data >> SCORE_SHIFT);
+            entry.move = (int)((data >> MOVE_SHIFT) & 0xFF) - 1;
+            entry.depth = dataDepth(data);
+            entry.bound = (Bound)((data >> BOUND_SHIFT) & 0x3);
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * Stores a search result. An existing entry for the same key is overwritten
+ * unless it came from a deeper search in this generation; otherwise the
+ * slot with the oldest generation and then the smallest depth is replaced.
+ */
+void TranspositionTable::store(uint64_t key, int depth, Bound bound, int score, int move) {
+    Bucket &bucket = buckets[key & bucketMask];
+    unsigned current = generation.load(std::memory_order_relaxed) & 0xFF;
+    Slot *victim = nullptr;
+    int victimValue = 1 << 30;
+
+    for (int i = 0; i < BUCKET_SLOTS; i++) {
+        Slot &slot = bucket.slots[i];
+        uint64_t data = slot.data.load(std::memory_order_relaxed);
+        uint64_t check = slot.check.load(std::memory_order_relaxed);
+        if (data != 0 && (check ^ data) == key) {
+            if (bound != BOUND_EXACT && dataGeneration(data) == current
+                    && dataDepth(data) > depth)
+                return;
+            victim = &slot;
+            break;
+        }
+
+        // entries of the running search are worth more than any older one
+        int value = dataDepth(data) + (dataGeneration(data) == current ? 256 : 0);
+        if (data == 0)
+            value = -1;
+        if (value < victimValue) {
+            victimValue = value;
+            victim = &slot;
+        }
+    }
+
+    uint64_t data = packData(depth, bound, score, move, current);
+    victim->data.store(data, std::memory_order_relaxed);
+    victim->check.store(key ^ data, std::memory_order_relaxed);
+}
@@ -0,0 +1,72 @@
+#ifndef __TT_H__
+#define __TT_H__
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+/*
+ * What a stored score says about the true score of the position.
+ */
+enum Bound {
+    BOUND_NONE,
+    BOUND_UPPER,    // search failed low: true score <= score
+    BOUND_LOWER,    // search failed high: true score >= score
+    BOUND_EXACT
+};
+
+/*
+ * A decoded transposition-table entry.
+ */
+struct TTEntry {
+    int score;
+    int move;       // best move id, or -1 if none is known
+    int depth;
+    Bound bound;
+};
+
+/*
+ * Fixed-size transposition table keyed by Zobrist hash.
+ *
+ * Entries are two 64-bit words (key and packed data) grouped four to a
+ * 64-byte bucket, so a probe touches a single cache line. When a bucket is
+ * full, the entry from the oldest search with the smallest depth is replaced.
+ *
+ * The table is shared by search threads without locks: the key word holds
+ * key ^ data, so an entry torn by two concurrent writers fails the check on
+ * probe and is treated as a miss.
+ */
+class TranspositionTable {
+
+private:
+    struct Slot {
+        std::atomic<uint64_t> check;    // key ^ data
+        std::atomic<uint64_t> data;
+    };
+
+    static const int BUCKET_SLOTS = 4;
+    struct alignas(64) Bucket {
+        Slot slots[BUCKET_SLOTS];
+    };
+
+    Bucket *buckets;
+    size_t bucketMask;
+    std::atomic<unsigned> generation;   // its low 8 bits are stored with each entry
+
+public:
+    TranspositionTable(size_t megabytes);
+    ~TranspositionTable();
+    TranspositionTable(const TranspositionTable &) = delete;
+    TranspositionTable &operator=(const TranspositionTable &) = delete;
+
+    bool probe(uint64_t key, TTEntry &entry);
+    void store(uint64_t key, int depth, Bound bound, int score, int move);
+
+    // age the table so that entries from earlier searches are replaced first;
+    // any thread may call it
+    void newSearch();
+    void clear();
+    size_t getSizeBytes() { return (bucketMask + 1) * sizeof(Bucket); }
+};
+
+#endif
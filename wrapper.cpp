@@ -21,27 +21,23 @@ int main(int argc, char *argv[]) {
 
     int moveX, moveY, msLeft;
 
-    // Get opponent's move and time left for player each turn.
+    // Get opponent's move and time left for player each turn. Moves are
+    // passed by value, so a turn allocates nothing.
     while (cin >> moveX >> moveY >> msLeft) {
-        Move *opponentsMove = nullptr;
-        if (moveX >= 0 && moveY >= 0) {
-            opponentsMove = new Move(moveX, moveY);
-        }
+        PackedMove opponentsMove = (moveX >= 0 && moveY >= 0) ? PackedMove(moveX, moveY) : PackedMove::pass();
 
         // Get player's move and output to java wrapper.
-        Move *playersMove = player->doMove(opponentsMove, msLeft);
-        if (playersMove != nullptr) {
-            cout << playersMove->x << " " << playersMove->y << endl;
+        PackedMove playersMove = player->play(opponentsMove, msLeft);
+        if (!playersMove.isPass()) {
+            cout << playersMove.getX() << " " << playersMove.getY() << endl;
         } else {
             cout << "-1 -1" << endl;
         }
         cout.flush();
         cerr.flush();
-
-        // Delete move objects.
-        if (opponentsMove != nullptr) delete opponentsMove;
-        if (playersMove != nullptr) delete playersMove;
     }
 
+    // stops a ponder search that may still be running
+    delete player;
     return 0;
 }
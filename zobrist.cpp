@@ -0,0 +1,30 @@
+#include "zobrist.hpp"
+
+uint64_t ZOBRIST_DISC[2][64];
+uint64_t ZOBRIST_FLIP[64];
+uint64_t ZOBRIST_SIDE;
+
+/*
+ * splitmix64: a small, well-mixed generator for the key tables.
+ */
+static uint64_t nextKey(uint64_t &state) {
+    uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+/*
+ * Fills the key tables before main() runs.
+ */
+static struct ZobristInit {
+    ZobristInit() {
+        uint64_t state = 0x0123456789ABCDEFULL;
+        for (int side = 0; side < 2; side++)
+            for (int sq = 0; sq < 64; sq++)
+                ZOBRIST_DISC[side][sq] = nextKey(state);
+        for (int sq = 0; sq < 64; sq++)
+            ZOBRIST_FLIP[sq] = ZOBRIST_DISC[WHITE][sq] ^ ZOBRIST_DISC[BLACK][sq];
+        ZOBRIST_SIDE = nextKey(state);
+    }
+} zobristInit;
@@ -0,0 +1,17 @@
+#ifndef __ZOBRIST_H__
+#define __ZOBRIST_H__
+
+#include <cstdint>
+#include "common.hpp"
+
+/*
+ * Zobrist keys for hashing positions. A position's key is the XOR of
+ * ZOBRIST_DISC[colour][square] over all discs; ZOBRIST_FLIP[square] turns a
+ * disc on that square over, and ZOBRIST_SIDE is mixed in when WHITE is to
+ * move. The keys come from a fixed seed, so hashes are stable across runs.
+ */
+extern uint64_t ZOBRIST_DISC[2][64];
+extern uint64_t ZOBRIST_FLIP[64];
+extern uint64_t ZOBRIST_SIDE;
+
+#endif